@@ -0,0 +1,356 @@
+// By: David Karhi
+//
+//   This is the header file for the Analyzer class. The analyzer does all
+//   of the semantic analysis in a single walk of the parse tree. On the
+//   way down it opens and closes scopes and remembers the function that
+//   it is in so returns can be checked. On the way back up it binds each
+//   variable and call to its declaration, folds constant operators, and
+//   works out the type of every expression once.
+//
+
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "parsenode.h"
+#include "symboltable.h"
+#include "visitor.h"
+
+class Analyzer : public TreeVisitor<Analyzer, Type>
+{
+   private:
+      SymbolTable &table;
+      ParseNode *root;
+      bool debug;
+      // the symbol table is dumped here when debugging
+      OutputBuffer &output;
+      bool mainDeclared;
+      int numErrors;
+      // the return type of the function that we are in
+      Type functionType;
+      // reports that a node was used as a void value
+      void voidError(ParseNode *node);
+   public:
+      // the analyzer puts its declarations in the given table
+      Analyzer(SymbolTable &symbols, bool dbug, OutputBuffer &out);
+      // analyzes the whole tree
+      void analyze(ParseNode *tree);
+      // returns numErrors
+      int getErrors(void) {return numErrors;}
+
+      Type visitFuncDecl(ParseNode *node);
+      Type visitVarDecl(ParseNode *node);
+      Type visitEndFunc(ParseNode *node);
+      Type visitReturnStmt(ParseNode *node);
+      Type visitNumExp(ParseNode *node);
+      Type visitVarExp(ParseNode *node);
+      Type visitCallExp(ParseNode *node);
+      Type visitOpExp(ParseNode *node);
+      Type visitRelExp(ParseNode *node);
+      Type visitAssignExp(ParseNode *node);
+};
+
+Analyzer::Analyzer(SymbolTable &symbols, bool dbug, OutputBuffer &out)
+   : table(symbols), output(out)
+{
+   root = NULL;
+   debug = dbug;
+   mainDeclared = false;
+   numErrors = 0;
+   functionType = Void;
+}
+
+void Analyzer::analyze(ParseNode *tree)
+{
+   root = tree;
+   visitList(root);
+   if (!mainDeclared)
+   {
+      cerr << "ERROR: Main Function Not Declared" << endl;
+      ++numErrors;
+   }
+}
+
+void Analyzer::voidError(ParseNode *node)
+{
+   cerr << "ERROR: Invalid Use of Void Type: ";
+   cerr << node->getString() << " ";
+   cerr << node->getLineNo() << endl;
+   ++numErrors;
+}
+
+Type Analyzer::visitFuncDecl(ParseNode *node)
+{
+   // the first node is the input function. Opening its scope puts both
+   // input and output in the table, so output is skipped.
+   if (node == root)
+   {
+      table.startScope(node);
+      if (debug)
+      {
+         table.displayTable(output);
+         table.displayStats(output);
+      }
+      return Void;
+   }
+   else if (node == root->getSibling())
+      return Void;
+
+   if (mainDeclared)
+   {
+      cerr << "ERROR: Function Declared After Main: ";
+      cerr << node->getString() << " " << node->getLineNo() << endl;
+      ++numErrors;
+   }
+
+   if (table.lookup(node) != NOSYMBOL)
+   {
+      // means the function has already been declared
+      cerr << "ERROR: Function Previously Declared: ";
+      cerr << node->getString() << " " << node->getLineNo() << endl;
+      ++numErrors;
+   }
+   if (node->isMainDecl())
+   {
+      if (node->getType() != Void)
+      {
+         cerr << "ERROR: Main Not Declared As Void Function" << endl;
+         ++numErrors;
+      }
+      mainDeclared = true;
+   }
+
+   table.startScope(node);
+   if (debug)
+   {
+      table.displayTable(output);
+      table.displayStats(output);
+   }
+
+   // the body ends with an EndFunc node, which closes the scope
+   functionType = node->getType();
+   visitChildren(node);
+   return Void;
+}
+
+Type Analyzer::visitVarDecl(ParseNode *node)
+{
+   // locals were put in the table when their function's scope started
+   if (node->getScope() == 0)
+      table.insert(node);
+   return Void;
+}
+
+Type Analyzer::visitEndFunc(ParseNode *node)
+{
+   // this removes all the things we don't need from the symbol table
+   table.endScope();
+   return Void;
+}
+
+Type Analyzer::visitReturnStmt(ParseNode *node)
+{
+   Type returnType = visit(node->getChild(0));
+
+   if (functionType == Void)
+   {
+      if (node->getChild(0) != NULL)
+      {
+         cerr << "ERROR: Void Function Returns A Value: ";
+         cerr << node->getLineNo() << " " << node->getPosition() << endl;
+         ++numErrors;
+      }
+   }
+   else if (functionType == Integer)
+   {
+      if (node->getChild(0) == NULL)
+      {
+         cerr << "ERROR: Integer Function Returns No Value: ";
+         cerr << node->getLineNo() << " " << node->getPosition() << endl;
+         ++numErrors;
+      }
+      else if (returnType != Integer)
+      {
+         cerr << "ERROR: Integer Function Does Not Return Integer: ";
+         cerr << node->getLineNo() << " " << node->getPosition() << endl;
+         ++numErrors;
+      }
+   }
+   return Void;
+}
+
+Type Analyzer::visitNumExp(ParseNode *node)
+{
+   return Integer;
+}
+
+Type Analyzer::visitVarExp(ParseNode *node)
+{
+   // the index of an array has to be bound before the array
+   visitChildren(node);
+
+   // a name that can't be bound is treated as an integer from here on
+   // so that it only causes one error
+   if (!table.bind(node))
+   {
+      cerr << "ERROR: Undeclared Variable: ";
+      cerr << node->getString() << " ";
+      cerr << node->getLineNo() << endl;
+      node->setType(Integer);
+      ++numErrors;
+   }
+   return node->getType();
+}
+
+Type Analyzer::visitCallExp(ParseNode *node)
+{
+   // the arguments are done first so that they have their types when
+   // the call is checked against the declaration
+   visitChildren(node);
+
+   if (table.bind(node))
+      table.checkParams(node);
+   else
+   {
+      cerr << "ERROR: Undeclared Function: ";
+      cerr << node->getString() << " " << node->getLineNo() << endl;
+      node->setType(Integer);
+      ++numErrors;
+   }
+   return node->getType();
+}
+
+Type Analyzer::visitOpExp(ParseNode *node)
+{
+   ParseNode *child0 = node->getChild(0);
+   ParseNode *child1 = node->getChild(1);
+   Type child0Type,child1Type;
+   int number = 0;
+   // the arithmetic is done unsigned so that an overflow wraps around
+   unsigned int a, b;
+
+   node->setType(Integer);
+   if (child0 == NULL || child1 == NULL)
+      return Integer;
+
+   child0Type = visit(child0);
+   child1Type = visit(child1);
+
+   if (child0->isRelOp() || child1->isRelOp())
+   {
+       cerr << "ERROR: Invalid Use of Relational Operator: ";
+       cerr << child0->getLineNo() << endl;
+       ++numErrors;
+   }
+   if (child0Type == Void)
+      voidError(child0);
+   if (child1Type == Void)
+      voidError(child1);
+
+   // we have already sent an error if an array was not
+   // declared as an int, so we can just do this quick
+   // conversion. If it is an array, we can be sure it is
+   // either declared as an int or an error has already
+   // been displayed
+   if (child0Type == Array)
+      child0Type = Integer;
+   if (child1Type == Array)
+      child1Type = Integer;
+
+   if (child0Type != child1Type)
+   {
+      cerr << "ERROR: Type Mismatch on Line ";
+      cerr << node->getLineNo() << endl;
+      ++numErrors;
+   }
+
+   // the children have already been folded, so if they are both numbers
+   // this operator can be folded into a number too
+   if (child0->isNum() && child1->isNum())
+   {
+      a = child0->getNum();
+      b = child1->getNum();
+      switch (node->getTokenType())
+      {
+         case PLUS:
+            number = a + b;
+            break;
+         case MINUS:
+            number = a - b;
+            break;
+         case STAR:
+            number = a * b;
+            break;
+         case DIV:
+            // dividing by zero, and the one quotient that doesn't fit,
+            // are left for the program to do
+            if (child1->getNum() == 0 ||
+                (child0->getNum() == (int)0x80000000 && child1->getNum() == -1))
+               return Integer;
+            number = child0->getNum() / child1->getNum();
+            break;
+         default:
+            break;
+      }
+
+      delete child0;
+      delete child1;
+      node->setChild(0,NULL);
+      node->setChild(1,NULL);
+      node->setExp(NumExp);
+      node->setNum(number);
+   }
+   return Integer;
+}
+
+Type Analyzer::visitRelExp(ParseNode *node)
+{
+   ParseNode *child0 = node->getChild(0);
+   ParseNode *child1 = node->getChild(1);
+
+   node->setType(Integer);
+   if (child0 == NULL || child1 == NULL)
+      return Integer;
+
+   visit(child0);
+   visit(child1);
+   if (child0->isCall() && child0->getType() == Void)
+      voidError(child0);
+   if (child1->isCall() && child1->getType() == Void)
+      voidError(child1);
+   return Integer;
+}
+
+Type Analyzer::visitAssignExp(ParseNode *node)
+{
+   ParseNode *child0 = node->getChild(0);
+   ParseNode *child1 = node->getChild(1);
+
+   if (child0 == NULL || child1 == NULL)
+      return Integer;
+
+   visit(child0);
+   visit(child1);
+
+   if (child0->isVar() && child0->getType() == Array)
+   {
+      cerr << "ERROR: Invalid Assignment: ";
+      cerr << child0->getString() << " ";
+      cerr << child0->getLineNo() << endl;
+      ++numErrors;
+   }
+
+   if (child1->isRelOp())
+   {
+      cerr << "ERROR: Can Not Assign Relational Operator: ";
+      cerr << child1->getLineNo() << endl;
+      ++numErrors;
+   }
+
+   if (child0->isCall() && child0->getType() == Void)
+      voidError(child0);
+   if (child1->isCall() && child1->getType() == Void)
+      voidError(child1);
+   return Integer;
+}
+
+#endif
@@ -0,0 +1,246 @@
+// By: David Karhi
+//
+//   This is the header file for the AsmPrinter class. The printer is the
+//   last pass of the code generator. It turns the machine code of each
+//   function, and the globals, into SPIM assembly text.
+//
+
+#ifndef ASMPRINTER_H
+#define ASMPRINTER_H
+
+#include "outputbuffer.h"
+#include "machinecode.h"
+#include "symboltable.h"
+
+// the label at the start of the small data, which $gp points at
+#define SMALLLABEL "_small"
+
+class AsmPrinter
+{
+   private:
+      OutputBuffer &out;
+      SymbolTable &table;
+      // these write one operand
+      void printReg(unsigned char r);
+      void printLabel(MachineFunction &f, int l);
+      void printAddress(MachineFunction &f, Instruction &i);
+   public:
+      // the names of the registers. The index corresponds to the
+      // enumerated type Reg.
+      const static char REG_NAMES[NUM_REGS][5];
+      // the SPIM names of the opcodes
+      const static char OPCODE_NAMES[NUMOPCODES][8];
+      // the names that labels start with. The index is the LabelKind.
+      const static char LABEL_NAMES[][8];
+      // the printer writes to out and finds names in table
+      AsmPrinter(OutputBuffer &o, SymbolTable &t) : out(o), table(t) {}
+      // writes the storage for a global variable
+      void printGlobal(ParseNode *node);
+      // writes the static storage of a function
+      void printStatic(MachineFunction &f);
+      // writes all of the code for a function
+      void printFunction(MachineFunction &f);
+      // writes a single instruction
+      void printInstruction(MachineFunction &f, Instruction &i);
+};
+
+const char AsmPrinter::REG_NAMES[][5] = {"zero","v0","v1","a0","a1","a2",
+            "a3","t0","t1","t2","t3","t4","t5","t6","t7","t8","t9","s0","s1",
+            "s2","s3","s4","s5","s6","s7","gp","sp","fp","ra"};
+
+const char AsmPrinter::OPCODE_NAMES[][8] = {"lw","sw","add","sub","jr",
+            "jal","li","syscall","move","addiu","mul","div","sll","slt",
+            "sle","sgt","sge","seq","sne","la","slti","lui","ori","sra",
+            "srl","mult","movz","movn","xor","addu","subu","beq","bne","blt",
+            "ble","bgt","bge","beqz","bnez","bltz","bgez","blez","bgtz","j",
+            "","nop","j"};
+
+const char AsmPrinter::LABEL_NAMES[][8] = {"L","L_END","ELSE","END_IF",
+            "_exit","_entry"};
+
+void AsmPrinter::printReg(unsigned char r)
+{
+   out << '$' << REG_NAMES[r];
+}
+
+void AsmPrinter::printLabel(MachineFunction &f, int l)
+{
+   MachineLabel &label = f.getLabel(l);
+
+   // there is one entry and one exit label in a function, so they are
+   // named after it
+   if (label.kind == ExitLabel || label.kind == EntryLabel)
+      out << f.getName() << LABEL_NAMES[label.kind];
+   else
+      out << LABEL_NAMES[label.kind] << label.number;
+}
+
+void AsmPrinter::printAddress(MachineFunction &f, Instruction &i)
+{
+   int offset;
+
+   switch (i.mode)
+   {
+      case RegAddress:
+         out << i.imm << "(";
+         printReg(i.rs);
+         out << ")";
+         break;
+      case SlotAddress:
+         // the stack pointer doesn't move after the prologue, so every
+         // slot is a fixed distance above it. Static storage is in the
+         // small data.
+         offset = f.getSlot(i.target).offset + i.imm;
+         if (f.isStatic() && f.getSlot(i.target).kind != ParamSlot)
+            out << f.getStaticBase() + offset << "($gp)";
+         else
+            out << f.getFrameSize() + offset << "($sp)";
+         break;
+      case GlobalAddress:
+         // A global in the small data is a fixed distance from $gp. The
+         // address of any other global takes a lui as well, and so does
+         // the start of the small data, which is where $gp is set up.
+         if ((unsigned int)i.target == NOSYMBOL)
+         {
+            out << SMALLLABEL;
+            break;
+         }
+         offset = table.getEntry(i.target).getMem() + i.imm;
+         if (table.getEntry(i.target).getMem() != NOTSMALL && i.rs == zero &&
+             offset >= 0 && offset < SMALLDATA)
+         {
+            out << offset << "($gp)";
+            break;
+         }
+         out << table.getEntry(i.target).getString();
+         if (i.imm > 0)
+            out << "+";
+         if (i.imm != 0)
+            out << i.imm;
+         if (i.rs != zero)
+         {
+            out << "(";
+            printReg(i.rs);
+            out << ")";
+         }
+         break;
+      default:
+         break;
+   }
+}
+
+void AsmPrinter::printGlobal(ParseNode *node)
+{
+   int size = 1;
+
+   if (node->getChild(0))
+      size = node->getChild(0)->getNum();
+   out << node->getString() << ":\n";
+   out << "   .space " << size*4 << '\n';
+}
+
+void AsmPrinter::printStatic(MachineFunction &f)
+{
+   out << f.getName() << "_frame:\n";
+   out << "   .space " << f.getStaticSize() << '\n';
+}
+
+void AsmPrinter::printFunction(MachineFunction &f)
+{
+   out << f.getName() << ":\n";
+   for (unsigned int i=0; i<f.code.size(); ++i)
+      printInstruction(f, f.code[i]);
+}
+
+void AsmPrinter::printInstruction(MachineFunction &f, Instruction &i)
+{
+   if (i.op == place)
+   {
+      printLabel(f, i.target);
+      out << ":\n";
+      return;
+   }
+
+   out << "   " << OPCODE_NAMES[i.op];
+   switch (i.op)
+   {
+      case add: case sub: case mul: case dvd: case slt: case sle:
+      case sgt: case sge: case seq: case sne: case movz: case movn: case eor:
+      case addu: case subu:
+         out << " ";
+         printReg(i.rd);
+         out << ", ";
+         printReg(i.rs);
+         out << ", ";
+         printReg(i.rt);
+         break;
+      case addiu: case sll: case slti: case ori: case sra: case srl:
+         out << " ";
+         printReg(i.rd);
+         out << ", ";
+         printReg(i.rs);
+         out << ", " << i.imm;
+         break;
+      case li: case lui:
+         out << " ";
+         printReg(i.rd);
+         out << ", " << i.imm;
+         break;
+      case mulhi:
+         out << " ";
+         printReg(i.rs);
+         out << ", ";
+         printReg(i.rt);
+         out << "\n   mfhi ";
+         printReg(i.rd);
+         break;
+      case mov:
+         out << " ";
+         printReg(i.rd);
+         out << ", ";
+         printReg(i.rs);
+         break;
+      case lw: case la:
+         out << " ";
+         printReg(i.rd);
+         out << ", ";
+         printAddress(f, i);
+         break;
+      case sw:
+         out << " ";
+         printReg(i.rt);
+         out << ", ";
+         printAddress(f, i);
+         break;
+      case beq: case bne: case blt: case ble: case bgt: case bge:
+         out << " ";
+         printReg(i.rs);
+         out << ", ";
+         printReg(i.rt);
+         out << ", ";
+         printLabel(f, i.target);
+         break;
+      case beqz: case bnez: case bltz: case bgez: case blez: case bgtz:
+         out << " ";
+         printReg(i.rs);
+         out << ", ";
+         printLabel(f, i.target);
+         break;
+      case jmp:
+         out << " ";
+         printLabel(f, i.target);
+         break;
+      case jl: case jt:
+         out << " " << table.getEntry(i.target).getString();
+         break;
+      case jr:
+         out << " ";
+         printReg(i.rs);
+         break;
+      default:
+         break;
+   }
+   out << '\n';
+}
+
+#endif
@@ -0,0 +1,182 @@
+// By: David Karhi
+//
+//   This is the header file for the CallGraph class. The call graph has
+//   an edge from each function to every function that it calls or tail
+//   calls. Its strongly connected components are found with Tarjan's
+//   algorithm. A function that is in a component with other functions, or
+//   that calls itself, might be active twice at once, and any other
+//   function never is, so it doesn't need a new frame for each call. A
+//   function that returns a call to itself jumps back to its start, so
+//   that isn't an edge.
+//
+//   Tarjan's algorithm finishes each component after every component that
+//   it calls, so that is also the order that the functions are compiled
+//   in. The callees of a function outside its own component are done by
+//   the time it is, and the registers that they change are known.
+//
+
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "outputbuffer.h"
+#include "machinecode.h"
+
+class CallGraph
+{
+   private:
+      // for each function, the functions that it calls, by their place in
+      // the list of functions
+      vector<vector<int> > calls;
+      // for each function, true if it calls itself
+      vector<bool> callsSelf;
+      // for each function, the order that the search reached it in, the
+      // earliest function that it reaches back to and its component
+      vector<int> order, lowLink, component;
+      // the functions whose component isn't known yet, and which of them
+      // are on that stack
+      vector<int> stack;
+      vector<bool> onStack;
+      // how many functions are in each component
+      vector<int> componentSize;
+      int nextOrder;
+      // the symbol of each function
+      vector<unsigned int> symbols;
+      // the functions with every function that they call before them,
+      // apart from the ones in their own component
+      vector<int> bottomUp;
+
+      // finds the components that can be reached from function f
+      void connect(int f);
+   public:
+      CallGraph();
+      // builds the graph from the calls in the code of the functions
+      void build(vector<MachineFunction> &functions);
+      // returns true if function f might be active twice at once
+      bool isRecursive(int f);
+      // returns true if functions f and g can be active at once with calls
+      // between them going both ways
+      bool sameComponent(int f, int g) {return component[f] == component[g];}
+      // returns the place of the function with the symbol in the list of
+      // functions, or -1 if it has no code
+      int findFunction(int symbol);
+      vector<int> &getBottomUp(void) {return bottomUp;}
+      // shows how many functions are recursive
+      void displayStats(OutputBuffer &out);
+};
+
+CallGraph::CallGraph()
+{
+   nextOrder = 0;
+}
+
+void CallGraph::build(vector<MachineFunction> &functions)
+{
+   unsigned int n = functions.size();
+   int g;
+
+   calls.assign(n, vector<int>());
+   callsSelf.assign(n, false);
+   symbols.resize(n);
+   for (unsigned int f=0; f<n; ++f)
+      symbols[f] = functions[f].getSymbol();
+   for (unsigned int f=0; f<n; ++f)
+   {
+      vector<Instruction> &code = functions[f].code;
+
+      for (unsigned int i=0; i<code.size(); ++i)
+      {
+         if (code[i].op != jl && code[i].op != jt)
+            continue;
+         g = findFunction(code[i].target);
+         if (g < 0)
+            continue;
+         calls[f].push_back(g);
+         if (g == (int)f)
+            callsSelf[f] = true;
+      }
+   }
+
+   order.assign(n, -1);
+   lowLink.assign(n, 0);
+   component.assign(n, -1);
+   onStack.assign(n, false);
+   stack.clear();
+   componentSize.clear();
+   bottomUp.clear();
+   nextOrder = 0;
+   for (unsigned int f=0; f<n; ++f)
+   {
+      if (order[f] < 0)
+         connect(f);
+   }
+}
+
+void CallGraph::connect(int f)
+{
+   int g;
+
+   order[f] = nextOrder;
+   lowLink[f] = nextOrder;
+   ++nextOrder;
+   stack.push_back(f);
+   onStack[f] = true;
+
+   for (unsigned int c=0; c<calls[f].size(); ++c)
+   {
+      g = calls[f][c];
+      if (order[g] < 0)
+      {
+         connect(g);
+         if (lowLink[g] < lowLink[f])
+            lowLink[f] = lowLink[g];
+      }
+      else if (onStack[g] && order[g] < lowLink[f])
+         lowLink[f] = order[g];
+   }
+
+   // f is the first function of its component that the search reached,
+   // so the component is everything above it on the stack
+   if (lowLink[f] != order[f])
+      return;
+   componentSize.push_back(0);
+   do
+   {
+      g = stack.back();
+      stack.pop_back();
+      onStack[g] = false;
+      component[g] = componentSize.size()-1;
+      ++componentSize.back();
+      bottomUp.push_back(g);
+   } while (g != f);
+}
+
+int CallGraph::findFunction(int symbol)
+{
+   // input and output have no code, so they aren't in the list
+   for (unsigned int f=0; f<symbols.size(); ++f)
+   {
+      if ((int)symbols[f] == symbol)
+         return f;
+   }
+   return -1;
+}
+
+bool CallGraph::isRecursive(int f)
+{
+   return callsSelf[f] || componentSize[component[f]] > 1;
+}
+
+void CallGraph::displayStats(OutputBuffer &out)
+{
+   unsigned int recursive = 0;
+
+   for (unsigned int f=0; f<calls.size(); ++f)
+   {
+      if (isRecursive(f))
+         ++recursive;
+   }
+   out << "Call graph: " << (unsigned int)calls.size() << " functions, ";
+   out << recursive << " recursive" << '\n';
+}
+
+#endif
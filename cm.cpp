@@ -5,6 +5,11 @@
 //   then parses the tokens into a parse tree. Finally, it performs 
 //   semantic analysis and generates SPIM assembly code.  It optionally 
 //   outputs debugging information to the screen.
+//
+//   Usage: cm <inputfile> [-d] [-o <outputfile>] [-fno-regalloc]
+//             [-fno-peephole[-<rule>]] [-fno-if-convert]
+//             [-fno-static-frames] [-fno-ipa-ra] [-fno-schedule]
+//             [--target-delays]
 //   
 //
 //  
@@ -12,6 +17,7 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include "options.h"
 #include "token.h"
 #include "tokenizer.h"
 #include "parser.h"
@@ -19,47 +25,78 @@
 
 using namespace std;
 
+// tells the user how the compiler is run
+void usage(void)
+{
+   cerr << "The compiler was not run with the proper arguments!!" << endl;
+   cerr << "Please specify a single input file as follows:";
+   cerr << endl << "cm <inputfile name> [-d] [-o <outputfile name>]";
+   cerr << " [-fno-regalloc] [-fno-peephole[-<rule>]]";
+   cerr << " [-fno-if-convert] [-fno-static-frames] [-fno-ipa-ra]";
+   cerr << " [-fno-schedule] [--target-delays]" << endl;
+   cerr << "If you want to output debugging information, add" << endl;
+   cerr << "the -d argument after the inputfile name." << endl;
+   cerr << "The assembly is written to " << DEFAULTOUTPUT << " unless" << endl;
+   cerr << "-o names another file. Use -o - to write it to the screen." << endl;
+   cerr << "-fno-regalloc keeps every variable in memory." << endl;
+   cerr << "-fno-peephole turns off the peephole optimizer, and" << endl;
+   cerr << "-fno-peephole-<rule> turns off one of its rules." << endl;
+   cerr << "-fno-if-convert keeps the branches of small if" << endl;
+   cerr << "statements instead of using conditional moves." << endl;
+   cerr << "-fno-static-frames keeps the slots of every function" << endl;
+   cerr << "in its stack frame." << endl;
+   cerr << "-fno-ipa-ra treats every call as changing all of" << endl;
+   cerr << "the caller-saved registers. Callees still save every" << endl;
+   cerr << "$s register they use either way." << endl;
+   cerr << "-fno-schedule keeps the instructions in the order" << endl;
+   cerr << "they are generated. --target-delays fills the branch" << endl;
+   cerr << "and load delay slots of a pipelined MIPS." << endl;
+}
+
 int main(int argc, char *argv[])
 {
-   bool debug;
+   Options options;
+   int rule;
 
-   // check if the program was run with the proper arguments
-   if(argc == 2)
+   // the input file comes first and the flags can follow in any order
+   if (argc < 2 || argv[1][0] == '-')
    {
-      debug = false;
-      // Instantiate the class
-      Parse parser (argv[1], debug);
-      
-      return EXIT_SUCCESS;
-   }
-   else if (argc == 3)
-   {
-      // check if we are supposed to output debugging information
-      if (strcmp(argv[2],"-d")==0)
-      {  
-         debug = true;
-         Parse parser (argv[1], debug);
-         return EXIT_SUCCESS;
-      }
-      else 
-      cerr << "The compiler was not run with the proper arguments!!" << endl;
-      cerr << "Please specify a single input file as follows:";
-      cerr << endl << "cm <inputfile name>" << endl;
-      cerr << "If you want to output debugging information, add" << endl;
-      cerr << "the -d argument after the inputfile name."<< endl;
+      usage();
       return EXIT_FAILURE;
-
    }
-   // if the number of arguments is not 2, then we give an error and die
-   else
+   options.inputFile = argv[1];
+
+   for (int i=2; i<argc; ++i)
    {
-      cerr << "The compiler was not run with the proper arguments!!" << endl;
-      cerr << "Please specify a single input file as follows:";
-      cerr << endl << "cm <inputfile name>" << endl;
-      cerr << "If you want to output debugging information, add" << endl;
-      cerr << "the -d argument after the inputfile name."<< endl;
-      return EXIT_FAILURE;
+      if (strcmp(argv[i],"-d") == 0)
+         options.debug = true;
+      else if (strcmp(argv[i],"-o") == 0 && i+1 < argc)
+         options.outputFile = argv[++i];
+      else if (strcmp(argv[i],"-fno-regalloc") == 0)
+         options.allocateRegisters = false;
+      else if (strcmp(argv[i],"-fno-peephole") == 0)
+         options.peepholeRules = 0;
+      else if (strncmp(argv[i],"-fno-peephole-",14) == 0 &&
+               (rule = Peephole::findRule(argv[i]+14)) >= 0)
+         options.peepholeRules &= ~(1u << rule);
+      else if (strcmp(argv[i],"-fno-if-convert") == 0)
+         options.ifConvert = false;
+      else if (strcmp(argv[i],"-fno-static-frames") == 0)
+         options.staticFrames = false;
+      else if (strcmp(argv[i],"-fno-ipa-ra") == 0)
+         options.callSummaries = false;
+      else if (strcmp(argv[i],"-fno-schedule") == 0)
+         options.schedule = false;
+      else if (strcmp(argv[i],"--target-delays") == 0)
+         options.targetDelays = true;
+      else
+      {
+         usage();
+         return EXIT_FAILURE;
+      }
    }
-}
-
 
+   // Instantiate the class
+   Parse parser (options);
+   return EXIT_SUCCESS;
+}
@@ -1,1014 +1,1640 @@
 // By: David Karhi
 //
-//   This is a code generator for a C- compiler
+//   This is a code generator for a C- compiler. generateSpim walks the
+//   parse tree and builds the machine code for each function (see
+//   machinecode.h). Once the whole program has been walked, the peephole
+//   pass cleans up each function, the register allocator moves its
+//   variables into registers and lets the slots that are left share
+//   storage, the frames are laid out and an AsmPrinter writes the
+//   assembly.
+//
+//   Expressions are worked out on a stack of registers, $t0 through $t3.
+//   The side of an operator that needs more registers goes first, when
+//   that doesn't change what the program does, and the other side uses
+//   the next register. A value only waits in a temporary slot of the
+//   frame when the registers run out or when the other side makes a
+//   call. The first four arguments are passed in $a0 through $a3 and the
+//   rest are stored at the bottom of the caller's frame, where the function
+//   finds them above the top of its own frame. The value is returned in
+//   $v0. The stack pointer only moves in the prologue and epilogue. A
+//   call whose value is returned is a jump: a function calling itself
+//   starts over in the same frame, and any other callee reuses the
+//   caller's return address once the frame is given back.
+//   Only the registers that a function changes are saved in its frame, so
+//   a function that makes no calls and keeps its variables in registers
+//   has no frame at all. A function that the call graph shows is never
+//   active twice at once keeps its slots and saved registers in static
+//   storage in the small data, so its frame only holds the arguments that
+//   it passes on the stack. The functions are finished callees first, and
+//   a call to a function that is already finished only gives up the
+//   registers that the function changes, so values can stay in $t
+//   registers across it.
+//   The scalars and small arrays among the globals are in the small data,
+//   which main points $gp at, so that a lw or sw reaches them in one
+//   instruction. A larger array is reached through its base address.
+//   An if statement that only assigns a few scalars has no branches. Its
+//   condition stays in $t0, each value is worked out whichever way the
+//   condition goes, and a movn or movz decides whether it is kept.
 //
 #ifndef CODE_GEN_H
 #define CODE_GEN_H
-#include <fstream>
+#include "options.h"
+#include "outputbuffer.h"
 #include "parsenode.h"
-
-typedef enum {lw,sw,add,sub,jr,jl,li,scall,move} Opcode;    
-
-#define NUM_V_REGS 2
-#define NUM_A_REGS 4
-#define NUM_T_REGS 10
-#define NUM_S_REGS 8
-#define NUM_REGS 28
+#include "symboltable.h"
+#include "machinecode.h"
+#include "asmprinter.h"
+#include "selector.h"
+#include "peephole.h"
+#include "regalloc.h"
+#include "scheduler.h"
+#include "callgraph.h"
 
 using namespace std;
 
+// the registers of the register stack are $t0 through $t3
+#define NUMSTACKREGS 4
+// what registersNeeded says about an expression with a call in it
+#define CALLNEEDS 1000
+// how many times the address of an array has to be worked out before its
+// base is kept in a slot for the register allocator. A use in a loop
+// counts as this many by itself.
+#define BASEUSES 2
+// the register that the sequences for a multiply or divide by a constant
+// keep their partial results in, and that holds the base address of a
+// large global array while one of its elements is loaded or stored
+#define SCRATCHREG v1
+// the most assignments an if statement can have and still be done with
+// conditional moves
+#define MAXSELECTS 4
+
 class CodeGenerator
 {
    private:
-      int numV;
-      int numA;
-      int numT; 
-      int tPointer;
-      int numS;      
-      // used is true if the register is being used. The index
-      // corresponds to the enumerated type Reg.
-      bool used[NUM_REGS];
-      ofstream outputFile;
-      char label[STRINGSIZE];
-      char exitLabel[STRINGSIZE];
-      char exitJumpString[STRINGSIZE];
-      char *whilelabel;
-      char *endlabel;
-      char *elselabel;
-      char *endiflabel;
-      int numParameters;
-      int numMemLocations;
+      // the assembly is collected here and written out in large blocks
+      OutputBuffer outputFile;
+      // the symbol table that the variables and calls are bound to
+      SymbolTable *table;
+      // the code of each function and the global variables, in the order
+      // that they are declared
+      vector<MachineFunction> functions;
+      vector<ParseNode *> globals;
+      // how many bytes of small data the globals and the static storage of
+      // the functions take
+      int smallData;
+      // the symbol of main, which sets up $gp
+      unsigned int mainSymbol;
+      // picks the instructions for the operators of expressions
+      InstructionSelector selector;
+      // cleans up the code of each function before its frame is laid out
+      Peephole peephole;
+      // keeps the variables of each function in registers
+      RegisterAllocator allocator;
+      bool allocateRegisters;
+      // true if small if statements use conditional moves, and true while
+      // the values of one are worked out, when an arm that doesn't run
+      // can't be allowed to trap
+      bool ifConvert;
+      bool speculating;
+      // finds the functions that can keep their slots in static storage,
+      // and the order that the functions are finished in
+      CallGraph callGraph;
+      bool staticFrames;
+      // true if calls only give up the registers that their callee changes
+      bool callSummaries;
+      // reorders the code of each function once its frame is laid out
+      Scheduler scheduler;
+      bool schedule;
+      // the function that code is being generated for, and its entry and
+      // exit labels
+      MachineFunction *function;
+      int entryLabel, exitLabel;
+      // the slot of each parameter of the function
+      vector<int> paramSlots;
+      // the arrays of the function whose base addresses are kept in
+      // slots, how often their addresses are worked out, and their slots
+      vector<unsigned int> baseSymbols;
+      vector<int> baseUses;
+      vector<int> baseSlots;
+      // the elements of arrays that both the condition and an arm of an
+      // if statement with conditional moves use, and the slots that keep
+      // them so that they are only loaded once
+      vector<ParseNode *> savedElements;
+      vector<int> savedSlots;
+      // the temporary slots of the function. Slot i holds the left side
+      // of an operator that is nested i operators deep.
+      vector<int> tempSlots;
+      unsigned int tempDepth;
+      // labels are numbered across the whole program
       int loopNum;
    public:
       CodeGenerator();
-      char *generateLabel(char *s);
-      char *generateExitLabel(char *s);
-      char *generateJumpLabel(char *s);
-      char *functionLabel(char *s);
+      void generateCode(ParseNode *root,SymbolTable &symbols,Options &options,
+                        int numErrors);
+      // shows how much code each function has
+      void displayStats(OutputBuffer &out);
       void generateFunctionCode(ParseNode *);
-      void generateCode(ParseNode *root,int numErrors);
+      // counts how often the address of each array in a tree is worked
+      // out, with each use counting as weight
+      void countArrayBases(ParseNode *node, int weight);
+      // returns the slot that holds the base address of an array, or -1
+      int findBaseSlot(unsigned int symbol);
+      // returns true if the static storage of a function is sure to fit
+      // in what is left of the small data
+      bool fitsStatic(MachineFunction &f);
+      // gives each call in function f the registers that its callee
+      // changes, when the callee is finished
+      void linkCalls(int f);
+      // works out the registers that a call to function f changes, once
+      // its code is finished
+      void summarizeCalls(int f);
+      // adds the code that sets up and tears down a function's frame
+      void generateFrameCode(MachineFunction &f);
+      // puts a global in the small data if it fits
+      void placeGlobal(ParseNode *node);
+      // generates a statement and the statements after it
       void generateSpim(ParseNode *treeNode);
-      void writeLabel(char *label);
       void writeReturn(ParseNode *node);
-      void printReg(int r);
-      Reg getRegister(void);
-      char* itoa (int);
- 
+      // generates a call whose value is returned as a jump that leaves the
+      // function, and returns false if the call can't be done that way
+      bool generateTailCall(ParseNode *node);
+      // these leave the value of an expression in the register at the
+      // given depth of the register stack, and only use the registers
+      // from there up
+      void generateExpression(ParseNode *node, unsigned int depth);
+      void generateCall(ParseNode *node, unsigned int depth);
+      // puts the arguments of a call where the callee expects them and
+      // returns how many there are. When self is true the call is a jump
+      // back to the start of this function.
+      int generateArguments(ParseNode *node, unsigned int depth, bool self);
+      void passArgument(Reg r, int argument, bool self);
+      void generateAssignment(ParseNode *node, unsigned int depth);
+      // generates an OpExp or RelExp with the pattern that the selector
+      // picks for it
+      void generateOperator(ParseNode *node, unsigned int depth);
+      // puts a constant in r
+      void loadConstant(Reg r, int value);
+      // these multiply or divide r by a constant without a mul or div.
+      // Like mul they wrap around on overflow, so they use addu and subu.
+      void multiplyConstant(Reg r, int value);
+      void divideConstant(Reg r, int value);
+      // works out both sides of an operator and says which registers
+      // they are in
+      void generateOperands(ParseNode *node, unsigned int depth,
+                            Reg &left, Reg &right);
+      // branches to label if the condition is the same as when
+      void generateCondition(ParseNode *node, int label, bool when);
+      // returns true if an if statement can be done with conditional
+      // moves instead of branches
+      bool canSelect(ParseNode *node);
+      // adds the assignments of an arm of an if statement to the list, and
+      // returns false if the arm has anything else in it
+      bool findSelects(ParseNode *node, vector<ParseNode *> &assignments);
+      // returns true if an expression can be worked out when the program
+      // wouldn't have, without anything going wrong
+      bool isSafe(ParseNode *node, ParseNode *cond,
+                  vector<ParseNode *> &assignments);
+      // returns true if tree works out the same thing as expression
+      // somewhere in it
+      bool readsSame(ParseNode *tree, ParseNode *expression);
+      bool sameExpression(ParseNode *a, ParseNode *b);
+      // returns true if an expression uses the variable
+      bool mentions(ParseNode *node, unsigned int symbol);
+      // generates an if statement with conditional moves
+      void generateSelect(ParseNode *node);
+      // leaves a value in $t0 for a condition and returns the conditional
+      // move that moves when the condition holds
+      Opcode generateTest(ParseNode *node);
+      // generates the assignments of an arm with the conditional move
+      void generateSelects(ParseNode *node, Opcode move);
+      // returns the slot that an element is saved in, or -1
+      int findSavedElement(ParseNode *node);
+      // leaves the address of a variable, or of an element of an array,
+      // in the register at depth
+      void generateAddress(ParseNode *node, unsigned int depth);
+      // returns true if a variable can be loaded or stored without
+      // working out its address first
+      bool isDirect(ParseNode *node);
+      // returns true if node passes an array in this function's frame
+      bool isLocalArray(ParseNode *node);
+      // loads or stores r for a variable that isDirect
+      void accessVariable(Opcode op, Reg r, ParseNode *node);
+      // returns how many registers an expression needs, which is
+      // CALLNEEDS if it has a call in it
+      int registersNeeded(ParseNode *node);
+      // returns true if an expression has a call or an assignment in it
+      bool hasSideEffects(ParseNode *node);
+      // returns true if an expression can be worked out at depth without
+      // running out of registers or changing the ones below it
+      bool fits(ParseNode *node, unsigned int depth);
+      // returns the register at a depth of the register stack
+      Reg stackReg(unsigned int depth);
+      // these save a register in the next temporary slot and load it back
+      void pushTemp(Reg r);
+      void popTemp(Reg r);
 };
 
 CodeGenerator::CodeGenerator()
 {
-   numV = 0;
-   numA = 0;
-   numT = 0;
-   numS = 0;
-   tPointer = 0;
-   numParameters = 0;
-   numMemLocations = 0;
+   table = NULL;
+   function = NULL;
+   allocateRegisters = true;
+   ifConvert = true;
+   speculating = false;
+   schedule = true;
+   exitLabel = NOLABEL;
+   smallData = 0;
+   mainSymbol = NOSYMBOL;
+   staticFrames = true;
+   callSummaries = true;
+   tempDepth = 0;
    loopNum = 0;
-
-   for (unsigned int i = 0; i < NUM_REGS; ++i)
-      used[i] = false;
 }
 
-char* CodeGenerator::itoa (int n){
-   int i=0,j;
-   char* s;
-   char* u;
-
-   s= (char*) malloc(17);
-   u= (char*) malloc(17);
-  
-   do
-   {
-      s[i++]=(char)( n%10+48 );
-      n-=n%10;
-   }
-   while((n/=10)>0);
-   for (j=0;j<i;j++)
-      u[i-1-j]=s[j];
-
-   u[j]='\0';
-   return u;
-}
-
-
-void CodeGenerator::generateCode(ParseNode *root,int numErrors)
+void CodeGenerator::generateCode(ParseNode *root,SymbolTable &symbols,
+                                 Options &options,int numErrors)
 {
+   ParseNode *node;
+
    if (numErrors > 0)
    {
       cerr << "Can Not Continue With Errors." << endl;
       cerr << "Exiting..." << endl;
       exit (EXIT_FAILURE);
-   }   
-   outputFile.open("output.asm");
-   if(outputFile.fail())
+   }
+   if(!outputFile.open(options.outputFile))
    {
       cerr << "Error opening output file!!" << endl << endl;
       exit(EXIT_FAILURE);
    }
 
-   generateSpim(root);
-   
-}
+   table = &symbols;
+   peephole.setRules(options.peepholeRules);
+   allocateRegisters = options.allocateRegisters;
+   ifConvert = options.ifConvert;
+   staticFrames = options.staticFrames;
+   callSummaries = options.callSummaries;
+   // the delay slots have to be filled even when nothing else is moved
+   schedule = options.schedule || options.targetDelays;
+   scheduler.setReorder(options.schedule);
+   scheduler.setDelays(options.targetDelays);
+   scheduler.setTable(symbols);
+   // input and output are built in, so they have no code
+   for (node = root; node; node = node->getSibling())
+   {
+      if (node->getSymbol() == table->getInput() ||
+          node->getSymbol() == table->getOutput())
+         continue;
+      if (node->getDeclType() == FuncDecl)
+         generateFunctionCode(node);
+      else if (node->getDeclType() == VarDecl)
+      {
+         placeGlobal(node);
+         globals.push_back(node);
+      }
+   }
 
-void CodeGenerator::generateSpim(ParseNode *treeNode)
-{
-   int offset = 0; 
-   int paramLocation;
+   // every call is in the code by now, tail calls included, and each
+   // function is finished after the ones it calls
+   callGraph.build(functions);
+   vector<int> &order = callGraph.getBottomUp();
+   for (unsigned int k=0; k<order.size(); ++k)
+   {
+      int i = order[k];
+
+      if (callSummaries)
+         linkCalls(i);
+      peephole.optimize(functions[i]);
+      // the moves that the allocator leaves are cleaned up by another
+      // peephole pass
+      if (allocateRegisters)
+      {
+         allocator.allocate(functions[i]);
+         peephole.optimize(functions[i]);
+      }
+      allocator.colorSlots(functions[i]);
+      if (staticFrames && !callGraph.isRecursive(i) && fitsStatic(functions[i]))
+         functions[i].setStatic(true);
+      functions[i].layoutFrame();
+      if (functions[i].isStatic())
+      {
+         functions[i].setStaticBase(smallData);
+         smallData += functions[i].getStaticSize();
+      }
+      generateFrameCode(functions[i]);
+      if (schedule)
+         scheduler.schedule(functions[i]);
+      functions[i].findBlocks();
+      if (callSummaries)
+         summarizeCalls(i);
+   }
 
-   if(!treeNode) return;
-   switch(treeNode->getNodeKind())
+   // the small data goes first, in the order of the offsets, which is the
+   // small globals and then the static storage
+   AsmPrinter printer(outputFile, symbols);
+   if (!globals.empty() || smallData > 0)
    {
-      case DeclKind:
-         if (strcmp(treeNode->getString(),"input") == 0 ||
-             strcmp(treeNode->getString(),"output") == 0)
-            break;
+      outputFile << ".data\n";
+      if (smallData > 0)
+         outputFile << SMALLLABEL << ":\n";
+      for (unsigned int i=0; i<globals.size(); ++i)
+      {
+         if (table->getEntry(globals[i]->getSymbol()).getMem() != NOTSMALL)
+            printer.printGlobal(globals[i]);
+      }
+      for (unsigned int k=0; k<order.size(); ++k)
+      {
+         if (functions[order[k]].getStaticSize() > 0)
+            printer.printStatic(functions[order[k]]);
+      }
+      for (unsigned int i=0; i<globals.size(); ++i)
+      {
+         if (table->getEntry(globals[i]->getSymbol()).getMem() == NOTSMALL)
+            printer.printGlobal(globals[i]);
+      }
+   }
+   outputFile << ".text\n";
+   for (unsigned int i=0; i<functions.size(); ++i)
+      printer.printFunction(functions[i]);
 
-         if(treeNode->isFuncBegin())
-         {
-            outputFile << ".text" << endl;
-            strcpy(label, generateLabel(treeNode->getString()));
-            strcpy(exitLabel, generateExitLabel(treeNode->getString()));
-            strcpy(exitJumpString, generateJumpLabel(treeNode->getString()));
-            writeLabel(label);
-            generateFunctionCode(treeNode);
-         }
-         else if(treeNode->getScope() == 0)
-         {
-            outputFile << ".data" << endl;
-            strcpy(label,generateLabel(treeNode->getString()));
-            writeLabel(label);
-            int size;
-            if (treeNode->getChild(0))
-               size = treeNode->getChild(0)->getNum();
-            else
-               size = 1;
-
-            size *= 4;
-            
-            outputFile << "   .space " << size << endl;
-         }
-         break;
-      case StmtKind:
-         switch(treeNode->getStmt())
-         {
-            case ReturnStmt:
-               writeReturn(treeNode);
-               break;
-            case WhileStmt:
-               whilelabel=generateLabel("L");
-               writeLabel(whilelabel);
-               if (treeNode->getChild(0)->isNum())
-               {  
-                  outputFile << "   add $t5, $zero, ";
-                  outputFile << treeNode->getChild(0)->getNum();
-                  outputFile << "   beqz $t5, L_END" << loopNum<< endl;
-               } 
-               else if (treeNode->getChild(0)->isVar())
-               {
-                  if (treeNode->getChild(0)->getParamNum() == MAXPARAMS)
-                  {
-                     paramLocation = treeNode->getChild(0)->getMem();
-                     if (treeNode->getChild(0)->getChild(0))
-                     {
-                        paramLocation += treeNode->getChild(0)->getChild(0)->getNum();
-                     }
-                     paramLocation *= 4;
-                     outputFile << "   lw $t5, " << -paramLocation << "($fp)" << endl;
+   // the assembly has to be out before any more debugging output
+   outputFile.flush();
+}
 
-                  }
-                  else
-                  {
-                     paramLocation = treeNode->getChild(0)->getParamNum();
-                     if (treeNode->getChild(0)->getChild(0))
-                        paramLocation -= treeNode->getChild(0)->getChild(0)->getNum();
-                     paramLocation *= 4;
-                     paramLocation =  ((numParameters - treeNode->getChild(0)->getParamNum()) * 4) - paramLocation;
-                     outputFile << "   lw $t5, " << paramLocation << "($fp)" << endl;
-                  }
-                  outputFile << "   beqz $t5, L_END" << loopNum << endl;
-               }
-               else if (treeNode->getChild(0)->isCall())
-               {
-                  generateSpim(treeNode->getChild(0));
-                  outputFile << "   move $t5, $a3" << endl;
-                  outputFile << "   beqz $t5, L_END" << loopNum << endl;
-               }
-               else if (treeNode->getChild(0)->isRelOp())
-               {
-                  generateSpim(treeNode->getChild(0)->getChild(0));
-                  if (treeNode->getChild(0)->getChild(0)->isCall())
-                  {
-                     outputFile << "   move $t4, $a3" << endl;
-                  }
-                  else
-                     outputFile << "   move $t4, $t5" << endl;
-                  
-                  generateSpim(treeNode->getChild(0)->getChild(1));
-                  if (treeNode->getChild(0)->getChild(1)->isCall())
-                     outputFile << "   move $t5, $a3" << endl;
- 
-                  switch (treeNode->getChild(0)->getTokenType())
-                  {
-                     case LEQ:
-                        outputFile << "   bgt $t4, $t5, " ;
-                        outputFile << "L_END" << loopNum << endl;
-                        break;
-                     case LT:
-                        outputFile << "   bge $t4, $t5, " ;
-                        outputFile << "L_END" << loopNum << endl;
-                        break;
-                     case GT:
-                        outputFile << "   ble $t4, $t5, " ;
-                        outputFile << "L_END" << loopNum << endl;
-                        break;
-                     case GEQ:
-                        outputFile << "   blt $t4, $t5, " ;
-                        outputFile << "L_END" << loopNum << endl;
-                        break;
-                     case EQ:
-                        outputFile << "   bne $t4, $t5, " ;
-                        outputFile << "L_END" << loopNum << endl;
-                        break;
-                     case NOTEQ:
-                        outputFile << "   beq $t4, $t5, " ;
-                        outputFile << "L_END" << loopNum << endl;
-                        break;
-                     default:
-                        break;
-                  }
-               }
- 
-               generateSpim(treeNode->getChild(1));
-               outputFile << "   j L" << loopNum << endl;
-               endlabel=generateLabel("L_END");
-               writeLabel(endlabel);
-               break;
-            case IfStmt:
-               if (treeNode->getChild(0)->isNum())
-               {
-                  outputFile << "   add $t5, $zero, ";
-                  outputFile << treeNode->getChild(0)->getNum();
-                  outputFile << "   beqz $t5, ELSE" << loopNum<< endl;
-               }
-               else if (treeNode->getChild(0)->isVar())
-               {
-                  if (treeNode->getChild(0)->getParamNum() == MAXPARAMS)
-                  {
-                     paramLocation = treeNode->getChild(0)->getMem();
-                     if (treeNode->getChild(0)->getChild(0))
-                     {
-                        paramLocation += treeNode->getChild(0)->getChild(0)->getNum();
-                     }
-                     paramLocation *= 4;
-                     outputFile << "   lw $t5, " << -paramLocation << "($fp)" << endl;
+void CodeGenerator::displayStats(OutputBuffer &out)
+{
+   unsigned int instructions;
 
-                  }
-                  else
-                  {
-                     paramLocation = treeNode->getChild(0)->getParamNum();
-                     if (treeNode->getChild(0)->getChild(0))
-                        paramLocation -= treeNode->getChild(0)->getChild(0)->getNum();
-                     paramLocation *= 4;
-                     paramLocation =  ((numParameters - treeNode->getChild(0)->getParamNum()) * 4) - paramLocation;
-                     outputFile << "   lw $t5, " << paramLocation << "($fp)" << endl;
-                  }
-                  outputFile << "   beqz $t5, ELSE" << loopNum << endl;
-               }
-               else if (treeNode->getChild(0)->isCall())
-               {
-                  generateSpim(treeNode->getChild(0));
-                  outputFile << "   move $t5, $a3" << endl;
-                  outputFile << "   beqz $t5, ELSE" << loopNum << endl;
-               }
-               else if (treeNode->getChild(0)->isRelOp())
-               {
-                  generateSpim(treeNode->getChild(0)->getChild(0));
-                  if (treeNode->getChild(0)->getChild(0)->isCall())
-                  {
-                     outputFile << "   move $t4, $a3" << endl;
-                  }
-                  else
-                     outputFile << "   move $t4, $t5" << endl;
-
-                  generateSpim(treeNode->getChild(0)->getChild(1));
-                  if (treeNode->getChild(0)->getChild(1)->isCall())
-                     outputFile << "   move $t5, $a3" << endl;
-                
-                  switch (treeNode->getChild(0)->getTokenType())
-                  {
-                     case LEQ:
-                        outputFile << "   bgt $t4, $t5, " ;
-                        outputFile << "ELSE" << loopNum << endl;
-                        break;
-                     case LT:
-                        outputFile << "   bge $t4, $t5, " ;
-                        outputFile << "ELSE" << loopNum << endl;
-                        break;
-                     case GT:
-                        outputFile << "   ble $t4, $t5, " ;
-                        outputFile << "ELSE" << loopNum << endl;
-                        break;
-                     case GEQ:
-                        outputFile << "   blt $t4, $t5, " ;
-                        outputFile << "ELSE" << loopNum << endl;
-                        break;
-                     case EQ:
-                        outputFile << "   bne $t4, $t5, " ;
-                        outputFile << "ELSE" << loopNum << endl;
-                        break;
-                     case NOTEQ:
-                        outputFile << "   beq $t4, $t5, " ;
-                        outputFile << "ELSE" << loopNum << endl;
-                        break;
-                     default:
-                        break;
-                  }
-               }
-
-               generateSpim(treeNode->getChild(1));
-               outputFile << "   j END_IF" << loopNum << endl;
-               elselabel=generateLabel("ELSE");
-               writeLabel(elselabel);
-               generateSpim(treeNode->getChild(2));
-               endiflabel=generateLabel("END_IF");
-               writeLabel(endiflabel);
-               break;
-            case CmpStmt:
-               generateSpim(treeNode->getChild(0));
-               break;
-            case ExpStmt:
-               generateSpim(treeNode->getChild(0));
-               break;
-            case FuncStmt:
-               generateSpim(treeNode->getChild(0));
-            default: break;
-	 }
-         break;
-      case ExpKind:
-         switch(treeNode->getExp()) 
-         {
-            case CallExp:
-               if (strcmp(treeNode->getString(),"input") == 0)
-               {
-                  outputFile << "   li $v0, 5" << endl;
-                  outputFile << "   syscall" << endl;
-               } 
-               else if (strcmp(treeNode->getString(),"output") == 0)
-               {
-                  // load the parameter into a0
-                  if (treeNode->getChild(0)->getParamNum() == MAXPARAMS)
-                  {
-                     paramLocation = treeNode->getChild(0)->getMem();
-                     if (treeNode->getChild(0)->getChild(0))
-                     {
-                        paramLocation += treeNode->getChild(0)->getChild(0)->getNum();
-                     }
-                     paramLocation *= 4;
-                     outputFile << "   lw $a0, " << -paramLocation << "($fp)" << endl;
-                     outputFile << "   li $v0, 1" << endl;
-                     outputFile << "   syscall" << endl;
-  
-                  }
-                  else
-                  {
-                     paramLocation = treeNode->getChild(0)->getParamNum();
-                     if (treeNode->getChild(0)->getChild(0))
-                        paramLocation -= treeNode->getChild(0)->getChild(0)->getNum();
-                     paramLocation *= 4;
-                     outputFile << "   lw $a0, " << paramLocation << "($fp)" << endl;
-                     outputFile << "   li $v0, 1" << endl;
-                     outputFile << "   syscall" << endl;
-                  }
-               }
-               else
-               {
-                  int argOffset = 0;
-                  int numArguments = 0;
-                  int argStackSize;
-                  int pointer;
-                  ParseNode *tmp;
-
-                  tmp = treeNode->getChild(0);
-                  while (tmp)
-                  {
-                    ++numArguments;
-                    tmp = tmp->getSibling();
-                  }
+   out << '\n';
+   for (unsigned int i=0; i<functions.size(); ++i)
+   {
+      instructions = 0;
+      for (unsigned int j=0; j<functions[i].code.size(); ++j)
+      {
+         if (functions[i].code[j].op != place)
+            ++instructions;
+      }
+      out << "Function " << functions[i].getName() << ": ";
+      out << instructions << " instructions in ";
+      out << (unsigned int)functions[i].getBlocks().size() << " blocks, ";
+      out << functions[i].getFrameSize() << " byte frame";
+      if (functions[i].getStaticSize() > 0)
+         out << ", " << functions[i].getStaticSize() << " bytes static";
+      out << '\n';
+   }
+   callGraph.displayStats(out);
+   if (allocateRegisters)
+      allocator.displayStats(out);
+   allocator.displaySlotStats(out);
+   peephole.displayStats(out);
+   if (schedule)
+      scheduler.displayStats(out);
+}
 
-                  // Allocate enough space on the stack for the arguments
-                  argStackSize = numArguments * 4;
-                  outputFile << "   sub $sp, $sp, " << argStackSize << endl;
+void CodeGenerator::generateFunctionCode(ParseNode* node)
+{
+   Entry &entry = table->getEntry(node->getSymbol());
+   unsigned int first = entry.getFirstLocal();
+   int words;
+   int slot;
+
+   functions.push_back(MachineFunction(node->getSymbol(), node->getString()));
+   function = &functions.back();
+   if (node->isMainDecl())
+      mainSymbol = node->getSymbol();
+   paramSlots.clear();
+   baseSymbols.clear();
+   baseUses.clear();
+   baseSlots.clear();
+
+   // the parameters and locals get the first slots, in the same order as
+   // their slots in the symbol table
+   for (unsigned int i=0; i<entry.getNumLocals(); ++i)
+   {
+      Entry &local = table->getEntry(first+i);
 
-                  tmp = treeNode->getChild(0);
-                  while(tmp)
-                  {
-                     if (tmp->isNum())
-                     { 
-                        if (numT >= NUM_T_REGS)
-                           tPointer=0;
-    
-                        if (numA == NUM_A_REGS)
-                           pointer = tPointer+7;
-                        else
-                        {  
-                           pointer = (argOffset/4)+3;
-                           ++numA;
-                        }
-
-                        outputFile << "   add $";
-                        printReg(pointer); 
-                        outputFile << ", $zero, ";
-                        outputFile << tmp->getNum() << endl; 
-                        outputFile << "   sw $"; 
-                        printReg(pointer); 
-                        outputFile << ", ";
-                        outputFile << argOffset << "($sp)" << endl;
-                        argOffset += 4;     
-                     }
-                     else 
-                     {
-                        if (tmp->getChild(0))
-                        {
-                           offset = tmp->getChild(0)->getNum();
-                           offset *= 4;
-                        }
-                        else 
-                           offset = 0;
-                        
-                        if (numT >= NUM_T_REGS)
-                           tPointer=0;
-
-                        if (numA == NUM_A_REGS)
-                           pointer = tPointer+7;
-                        else
-                        {
-                           pointer = (argOffset/4)+3;
-                           ++numA;
-                        }
-
-                        if (tmp->getParamNum() == MAXPARAMS)
-                        {
-                           offset += (tmp->getMem() * 4);
-                           offset += 8;
-                           
-                           outputFile << "   lw $";
-                           printReg(pointer);
-                           outputFile << ", " << -offset;
-                           outputFile << "($fp)" << endl;
-                           outputFile << "   sw $"; 
-                           printReg(pointer);
-                           outputFile << ", " << argOffset << "($sp)" << endl; 
-                           argOffset += 4;  
-                        }      
-                        else
-                        {
-                           offset =  ((numArguments - tmp->getParamNum()) * 4) - offset;
-                           outputFile << "   lw $";
-                           printReg(pointer);
-                           outputFile << ", " << offset;
-                           outputFile << "($fp)" << endl;
-                           outputFile << "   sw $";
-                           printReg(pointer);
-                           outputFile << ", " << argOffset << "($sp)" << endl;
-                           argOffset += 4;
-                        }
-                     }
-                     tmp = tmp->getSibling();
-                  }
-                  outputFile << "   jal " << treeNode->getString() << endl; 
-                  outputFile << "   add $sp, $sp, " << argStackSize << endl;
-               }
-               break;
-            case OpExp:
-               if (treeNode->getChild(0)->isCall())
-               {
-                  generateSpim(treeNode->getChild(0));
-                  outputFile << "   move $s1, $v0" << endl;
-               }
-               if (treeNode->getChild(1)->isCall())
-               {
-                  generateSpim(treeNode->getChild(1));
-                  outputFile << "   move $s2, $v0" << endl;
-               }  
-
-               if (treeNode->getChild(0)->isNum())
-               {
-                  outputFile << "   add $s1, $zero, ";
-                  outputFile << treeNode->getChild(0)->getNum() << endl;
-               }
-               if (treeNode->getChild(1)->isNum())
-               {
-                  outputFile << "   add $s2, $zero, ";
-                  outputFile << treeNode->getChild(0)->getNum() << endl;
-               }
-               if (treeNode->getChild(0)->isVar())
-               {
-                  if (treeNode->getChild(0)->getChild(0))
-                  {
-                     offset = treeNode->getChild(0)->getChild(0)->getNum();
-                     offset *= 4;
-                  }
-                  else 
-                     offset = 0;
+      if (local.getParamNum() != NOTPARAM)
+      {
+         slot = function->newSlot(local.getParamNum() >= NUMARGREGS ?
+                                  ParamSlot : LocalSlot, 1);
+         if (paramSlots.size() <= (unsigned int)local.getParamNum())
+            paramSlots.resize(local.getParamNum()+1);
+         paramSlots[local.getParamNum()] = slot;
+      }
+      else
+      {
+         words = local.getArraySize();
+         if (words == 0)
+            words = 1;
+         function->newSlot(LocalSlot, words);
+      }
+   }
+   tempSlots.clear();
+   tempDepth = 0;
+
+   // An array whose address is worked out often has its base address put
+   // in a slot once, which the register allocator can keep in a register
+   // so that an element only takes a shift and an add. Without the
+   // allocator the slot would be loaded every time, which is no better
+   // than working the address out.
+   if (allocateRegisters)
+      countArrayBases(node->getChild(1), 1);
+   for (unsigned int b=0; b<baseSymbols.size(); ++b)
+   {
+      Entry &array = table->getEntry(baseSymbols[b]);
 
-                  if (treeNode->getChild(0)->getParamNum() == MAXPARAMS)
-                  {
-                     offset += (treeNode->getChild(0)->getMem() * 4);
-                     offset += 8;
-                     
-                     outputFile << "   lw $s1, " << -offset;
-                     outputFile <<"($fp)" << endl;
-                  }
-                  else
-                  {
-                     offset =  ((numParameters - treeNode->getChild(0)->getParamNum()) * 4) - offset;
-                     
-                     outputFile << "   lw $s1, " << offset;
-                     outputFile <<"($fp)" << endl;
-                  }
-               }
-               if (treeNode->getChild(1)->isVar())
-               {
-                  if (treeNode->getChild(1)->getChild(0))
-                  {
-                     offset = treeNode->getChild(1)->getChild(0)->getNum();
-                     offset *= 4;
-                  }
-                  else
-                     offset = 0;
+      if (baseUses[b] < BASEUSES)
+      {
+         baseSlots.push_back(-1);
+         continue;
+      }
+      baseSlots.push_back(function->newSlot(LocalSlot, 1));
+      if (array.getScope() == 0)
+         function->emitMem(la, stackReg(0), GlobalAddress, zero, baseSymbols[b], 0);
+      else
+         function->emitMem(la, stackReg(0), SlotAddress, zero, array.getSlot(), 0);
+      function->emitMem(sw, stackReg(0), SlotAddress, zero, baseSlots[b], 0);
+   }
 
-                  if (treeNode->getChild(1)->getParamNum() == MAXPARAMS)
-                  {
-                     offset += (treeNode->getChild(1)->getMem() * 4);
-                     offset += 8;
+   // A call to the function from its own return statement jumps back to
+   // here with the new arguments. The parameters that come in registers
+   // are stored to slots in the frame like locals, which the register
+   // allocator turns back into registers.
+   entryLabel = function->newLabel(EntryLabel, 0);
+   function->emitLabel(entryLabel);
+   for (unsigned int p=0; p<paramSlots.size() && p<NUMARGREGS; ++p)
+      function->emitMem(sw, (Reg)(a0+p), SlotAddress, zero, paramSlots[p], 0);
 
-                     outputFile << "   lw $s2, " << -offset;
-                     outputFile <<"($fp)" << endl;
-                  }
-                  else
-                  {
-                     offset =  ((numParameters - treeNode->getChild(1)->getParamNum()) * 4) - offset;
+   exitLabel = function->newLabel(ExitLabel, 0);
+   generateSpim(node->getChild(1));
+   function->emitLabel(exitLabel);
+}
 
-                     outputFile << "   lw $s2, " << offset;
-                     outputFile <<"($fp)" << endl;
-                  }
-               }
-               if (treeNode->getChild(0)->isMathOperator())
-               {
-                  generateSpim(treeNode->getChild(0));
-                  
-                  outputFile << "   move $s1, $s3" << endl; 
-               }
-               if (treeNode->getChild(1)->isMathOperator())
-               {
-                  generateSpim(treeNode->getChild(0));
+void CodeGenerator::placeGlobal(ParseNode *node)
+{
+   Entry &global = table->getEntry(node->getSymbol());
+   int bytes = 4;
 
-                  outputFile << "   move $s2, $s3" << endl;
-               }
-               
-               switch (treeNode->getTokenType()) 
-               {
-                  case PLUS:
-                     outputFile << "   add $s3, $s1, $s2" << endl;
-                     break;
-                  case MINUS:
-                     outputFile << "   sub $s3, $s1, $s2" << endl;
-                     break;
-                  case STAR:
-                     outputFile << "   mul $s3, $s1, $s2" << endl;
-                     break;
-                  case DIV:
-                     outputFile << "   div $s3, $s1, $s2" << endl;
-                     break;
-                  default:
-                     break;
-               }
-            case AssignExp:
-               if (treeNode->getChild(1)->isCall())
-               {
-                  generateSpim(treeNode->getChild(1));
-                  outputFile << "   add $s0, $zero, $v0" << endl;
-               }
-               else if (treeNode->getChild(1)->isNum())
-               {
-                  outputFile << "   add $s0, $zero, ";
-                  outputFile << treeNode->getChild(1)->getNum() << endl;
-               }   
-               else if (treeNode->getChild(1)->isVar())
-               {
-                  if(treeNode->getChild(1)->getChild(0))
-                  {
-                     offset = treeNode->getChild(1)->getChild(0)->getNum();
-                     offset *= 4; 
-                  }
-                  else 
-                     offset = 0;
-                  
-                  if (treeNode->getChild(1)->getParamNum() == MAXPARAMS)
-                  {
-                     offset += (treeNode->getChild(1)->getMem() * 4);
-                     offset += 8;
+   if (global.getArraySize() > 0)
+      bytes = 4*global.getArraySize();
+   if (bytes > SMALLGLOBAL || smallData + bytes > SMALLDATA)
+   {
+      global.setMem(NOTSMALL);
+      return;
+   }
+   global.setMem(smallData);
+   smallData += bytes;
+}
 
-                     outputFile << "   lw $s0, " << -offset;
-                     outputFile << "($fp)" << endl;
-                  }
-                  else 
-                  {
-                     offset =  ((numParameters - treeNode->getParamNum()) * 4) - offset;
-                     outputFile << "   lw $s0, " << offset;
-                     outputFile << "($fp)" << endl;
-                  }   
-               }
-               else if (treeNode->getChild(1)->isMathOperator())
-               {
-                  generateSpim(treeNode->getChild(1));
-                  outputFile << "   move $s0, $s3" << endl;
-               }
-               
-               if (treeNode->getChild(0)->getChild(0))
-               {
-                  offset = treeNode->getChild(0)->getChild(0)->getNum();
-                  offset *= 4;
-               }
-               else
-                  offset = 0;
-
-               if (treeNode->getChild(0)->getParamNum() == MAXPARAMS)
-               {
-                  offset += (treeNode->getChild(0)->getMem() * 4);
-                  offset += 8;
-
-                  outputFile << "   sw $s0, " << -offset;
-                  outputFile << "($fp)" << endl;
-               }
-               else
-               {
-                  offset = ((numParameters - treeNode->getParamNum()) * 4) - offset;
-                  outputFile << "   sw $s0, " << offset;
-                  outputFile << "($fp)" << endl;
-               }
-               break;
-            case NumExp: 
-               outputFile << "   add $t5, $zero, ";
-               outputFile << treeNode->getNum() << endl;
-               break;
-            case VarExp: 
-               if (treeNode->getChild(0))
-               {
-                  offset = treeNode->getChild(0)->getNum();
-                  offset *= 4;
-               }
-               else
-                  offset = 0;
-
-               if (treeNode->getParamNum() == MAXPARAMS)
-               {
-                  offset += (treeNode->getMem() * 4);
-                  outputFile << "   lw $t5, " << -offset << "($fp)" << endl;
-
-               }
-               else
-               {
-                  offset = ((numParameters - treeNode->getParamNum()) * 4) - offset;
-                  outputFile << "   lw $t5, " << offset << "($fp)" << endl;
-               }
-               break;
-            default: 
+void CodeGenerator::countArrayBases(ParseNode *node, int weight)
+{
+   unsigned int b;
+
+   for (; node; node = node->getSibling())
+   {
+      // only an index that isn't a constant, or passing the array, needs
+      // the base address of an array in the frame or the small data. An
+      // array outside the small data needs it for any element.
+      if (node->getNodeKind() == ExpKind && node->getExp() == VarExp &&
+          (node->getType() == Array ||
+           (node->getChild(0) && !node->getChild(0)->isNum()) ||
+           (node->getChild(0) &&
+            table->getEntry(node->getSymbol()).getScope() == 0 &&
+            table->getEntry(node->getSymbol()).getMem() == NOTSMALL)) &&
+          table->getEntry(node->getSymbol()).getParamNum() == NOTPARAM)
+      {
+         for (b=0; b<baseSymbols.size(); ++b)
+         {
+            if (baseSymbols[b] == node->getSymbol())
                break;
          }
+         if (b == baseSymbols.size())
+         {
+            baseSymbols.push_back(node->getSymbol());
+            baseUses.push_back(0);
+         }
+         baseUses[b] += weight;
+      }
+      if (node->getNodeKind() == StmtKind && node->getStmt() == WhileStmt)
+      {
+         for (int c=0; c<MAXCHILDREN; ++c)
+            countArrayBases(node->getChild(c), BASEUSES);
       }
-   
-   generateSpim(treeNode->getSibling());
-   return;
+      else
+      {
+         for (int c=0; c<MAXCHILDREN; ++c)
+            countArrayBases(node->getChild(c), weight);
+      }
+   }
 }
 
-char *CodeGenerator::generateLabel( char* s)
+int CodeGenerator::findBaseSlot(unsigned int symbol)
 {
-   char *returnString = label;
-
-   strcpy(returnString,s);
-   
-   if (strcmp(s, "L") == 0 || strcmp(s, "ELSE") == 0)
-      strcat(returnString, itoa(loopNum));
-   if ( strcmp(s, "L_END") == 0 || strcmp(s, "END_IF") == 0)
+   for (unsigned int b=0; b<baseSlots.size(); ++b)
    {
-      strcat(returnString, itoa(loopNum));
-      ++loopNum;
+      if (baseSymbols[b] == symbol)
+         return baseSlots[b];
    }
-   strcat(returnString,":");
-
-   return returnString;
+   return -1;
 }
 
-char *CodeGenerator::generateExitLabel( char* s)
+bool CodeGenerator::fitsStatic(MachineFunction &f)
 {
-   char *returnString = exitLabel;
+   int words = 0;
 
-   strcpy (returnString,s);
-   strcat (returnString,"_exit:");
-
-   return returnString;
+   // the storage is only laid out once the function is known to be
+   // static, so this counts every slot and every register it could save
+   for (unsigned int s=0; s<f.getNumSlots(); ++s)
+   {
+      if (f.getSlot(s).kind != ParamSlot)
+         words += f.getSlot(s).words;
+   }
+   for (int r=zero; r<=ra; ++r)
+   {
+      if (CALLEE_SAVED & REGBIT(r))
+         ++words;
+   }
+   return smallData + 4*words <= SMALLDATA;
 }
 
-char *CodeGenerator::generateJumpLabel( char* s)
+void CodeGenerator::linkCalls(int f)
 {
-   char *returnString = exitJumpString;
+   vector<Instruction> &code = functions[f].code;
+   int g;
 
-   strcpy (returnString,s);
-   strcat (returnString,"_exit");
-
-   return returnString;
+   // a callee in the same component might not be finished, so calls to it
+   // keep the usual convention
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].op != jl)
+         continue;
+      g = callGraph.findFunction(code[i].target);
+      if (g >= 0 && !callGraph.sameComponent(f, g))
+         code[i].clobbers = functions[g].getClobbers();
+   }
 }
 
-void CodeGenerator::writeLabel(char *label)
+void CodeGenerator::summarizeCalls(int f)
 {
-   outputFile << label << endl;
-}
+   vector<Instruction> &code = functions[f].code;
+   unsigned int changed = REGBIT(ra);
+   int g;
 
-void CodeGenerator::generateFunctionCode(ParseNode* node)
-{
-   // input and output functions are ignored
-   if (strcmp(node->getString(),"input") == 0 || 
-       strcmp(node->getString(),"output") == 0)
+   // a recursive function keeps the usual convention for its callers too
+   if (callGraph.isRecursive(f))
       return;
-
-   numMemLocations=0;
-   ParseNode* tmp;
-   int saveS = numS;
-   
-   numParameters = 0;
-   // this is a function declaration, so first we need to figure out
-   // how many variables and parameters are declared so that we can 
-   // allocate the stack.
-   tmp = node->getChild(0);
-   while (tmp)
-   {
-      ++numParameters;
-      tmp = tmp->getSibling();
-   }
-  
-   tmp = node->getChild(1); 
-   if(tmp)
-      tmp = node->getChild(0);
-  
-   while (tmp)
-   {  
-      // if this is a variable declaration, allocate space for the variable
-      if (tmp->isVarDecl()) {
-         // if this is an array, add the index so we can allocate enough space
-         if (tmp->getChild(0))
-            numMemLocations += tmp->getChild(0)->getNum();
-         else
-            ++numMemLocations;
-      }
- 
-      tmp = tmp->getSibling();
-   }
-   
-   // check how many S registers are used so we can save them
-   if (numS > 0)
-      numMemLocations+=numS;
-
-   // finally, add 2 to the number of memory locations to save the 
-   // return address and frame pointer. Multiply the whole thing by
-   // 4 to get the actual number of bytes needed.      
-   numMemLocations += 2;
-   numMemLocations *= 4;
- 
-   // write the memory allocation
-   outputFile << "   sub $sp, $sp, " << numMemLocations << endl;
-
-   // save the frame pointer and the return address
-   outputFile << "   sw $fp, " << numMemLocations - 4 << "($sp)" << endl; 
-   outputFile << "   sw $ra, " << numMemLocations - 8 << "($sp)" << endl;
-   
-   // now the new frame pointer is assigned
-   outputFile << "   add $fp, $sp, " << numMemLocations << endl;
-
-   // save and clear the S registers
-   int savedLocation = numMemLocations - 8;
-   if (numS > 0)
-   {
-      for ( int i = 17; i < 25; ++i)
-      {
-         if (used[i])
-         {
-            outputFile << "   sw $";
-            printReg(i);
-            outputFile << ", ";
-            outputFile << savedLocation << "$(sp)" << endl;
-
-            savedLocation += 4;
-            used[i] = false;
-         } 
-      } 
-      numS = 0;
-   }
-   
-   strcpy(exitLabel, generateExitLabel(node->getString()));
-   generateSpim(node->getChild(1));
-   writeLabel(exitLabel);
-
-   int index;
-   // restore the S registers
-   if (saveS > 0)
+   for (unsigned int i=0; i<code.size(); ++i)
    {
-      numS = saveS;
-      saveS *= 4;
-      savedLocation += 4;
-      while (saveS > 0)
+      changed |= regsWritten(code[i]);
+      // a tail call leaves the callee to change registers for this function
+      if (code[i].op == jt)
       {
-         // figure out which register we need to restore
-         index = (17+(saveS/4));
-         saveS -= 4;
-         outputFile << "   lw ";
-         printReg(index);
-         outputFile << ", " << savedLocation << "($sp)" << endl; 
-         used[index] = true;
-         savedLocation -= 4;
-      } 
+         g = callGraph.findFunction(code[i].target);
+         if (g >= 0)
+            changed |= functions[g].getClobbers();
+         else
+            changed |= CALLER_SAVED;
+      }
    }
+   // the saved registers and $sp are given back the way they were found
+   changed &= ~(CALLEE_SAVED & ~REGBIT(ra)) & ~REGBIT(sp);
+   functions[f].setClobbers(changed);
+}
 
-   // restore the return address and frame pointer, then restore the 
-   // stack    
-   outputFile << "   lw $fp, " << numMemLocations - 4 << "($sp)" << endl;
-   outputFile << "   lw $ra, " << numMemLocations - 8 << "($sp)" << endl;
-
-   outputFile << "   add $sp, $sp, " << numMemLocations << endl;
+void CodeGenerator::generateFrameCode(MachineFunction &f)
+{
+   int size = f.getFrameSize();
+   MachineFunction prologue(f.getSymbol(), f.getName());
+   MachineFunction epilogue(f.getSymbol(), f.getName());
+   bool exitUsed = false;
+   unsigned int i;
+
+   // main points $gp at the small data before anything can use it, its
+   // own static storage included
+   if (f.getSymbol() == mainSymbol && smallData > 0)
+      prologue.emitMem(la, gp, GlobalAddress, zero, NOSYMBOL, 0);
+
+   // save the registers that the function changes and has to give back
+   if (size > 0)
+      prologue.emitImm(addiu, sp, sp, -size);
+   for (unsigned int s=0; s<f.getNumSlots(); ++s)
+   {
+      FrameSlot &slot = f.getSlot(s);
 
-   // return
-   outputFile << "   jr $ra" << endl;
-   
-}  
+      if (slot.kind == SaveSlot)
+         prologue.emitMem(sw, (Reg)slot.reg, SlotAddress, zero, s, 0);
+   }
+   f.code.insert(f.code.begin(), prologue.code.begin(), prologue.code.end());
 
-void CodeGenerator::writeReturn(ParseNode *node)
-{
-   int offset = 0;
-   int registerVal;
-   int variableLocation;
+   // The exit label is at the end, so this is where every return goes. A
+   // tail call gives back the frame before it jumps, so that the callee
+   // returns straight to this function's caller.
+   for (unsigned int s=0; s<f.getNumSlots(); ++s)
+   {
+      FrameSlot &slot = f.getSlot(s);
 
-   if (node->getChild(0))
+      if (slot.kind == SaveSlot)
+         epilogue.emitMem(lw, (Reg)slot.reg, SlotAddress, zero, s, 0);
+   }
+   if (size > 0)
+      epilogue.emitImm(addiu, sp, sp, size);
+   for (i=0; i<f.code.size(); ++i)
    {
-      if (node->getChild(0)->isNum())
-      {
-         outputFile << "   add $v0, $zero, " ;
-         outputFile << node->getChild(0)->getNum() << endl;
-      }   
-      else if (node->getChild(0)->isVar())
+      if (f.code[i].op == jt)
       {
-         // check if this is an array value
-         if (node->getChild(0)->getChild(0))
-            offset = node->getChild(0)->getChild(0)->getNum();
-         offset *= 4;
+         f.code.insert(f.code.begin()+i, epilogue.code.begin(), epilogue.code.end());
+         i += epilogue.code.size();
+      }
+   }
 
-         if (node->getChild(0)->getScope() == 0)
+   // with nothing to undo a return can leave right away
+   for (i=0; i<f.code.size(); ++i)
+   {
+      if (f.code[i].op == jmp && f.getLabel(f.code[i].target).kind == ExitLabel)
+      {
+         if (epilogue.code.empty())
          {
-            // find an available register. If the registers are full,
-            // replace the first value we inserted.
-            if (numT >= NUM_T_REGS)
-               tPointer = 0;
-
-            registerVal = 7 + tPointer;
-            outputFile << "   add $";
-            printReg(registerVal); 
-            outputFile << ", $zero, ";
-            outputFile << offset << endl;
-            outputFile << "   lw $v0, " << node->getChild(0)->getString();
-            outputFile << "($";
-            printReg(registerVal);
-            outputFile << ")" << endl;   
+            f.code[i].op = jr;
+            f.code[i].rs = ra;
          }
          else
-         {
-            if (node->getChild(0)->getParamNum() == MAXPARAMS)
-            {
-               variableLocation = node->getMem();
-               // offset for the return address and the saved frame pointer
-               // since we are basing this off of the frame pointer
-               variableLocation += 3;
-               variableLocation *= 4;
-               variableLocation += offset;
-               
-               outputFile << "   lw $v0, " << -variableLocation; 
-               outputFile << "($fp)" << endl; 
-            }
-            // if we get here it is a parameter that we are looking for
-            else
-            {
-               variableLocation = node->getParamNum();
-               variableLocation = numParameters - variableLocation;
+            exitUsed = true;
+      }
+   }
 
-               variableLocation *= 4;
-               variableLocation -= offset;
+   // the epilogue is left out when every path has already left, such as
+   // when the function ends in a tail call
+   for (i=f.code.size(); i>0; --i)
+   {
+      Instruction &last = f.code[i-1];
 
-               outputFile << "   lw $v0, " << variableLocation;
-               outputFile << "($fp)" << endl;
-            }
-         }
+      if (last.op == place &&
+          (f.getLabel(last.target).kind != ExitLabel || exitUsed))
+         break;
+      if (last.op != place && last.op != nop)
+      {
+         if (endsBlock(last) && !isConditional(last))
+            return;
+         break;
       }
-      else if (node->getChild(0)->isCall() ||
-               node->getChild(0)->isMathOperator())
+   }
+   f.code.insert(f.code.end(), epilogue.code.begin(), epilogue.code.end());
+   f.emit(jr, zero, ra, zero);
+}
+
+void CodeGenerator::generateSpim(ParseNode *treeNode)
+{
+   int labelNum;
+   int top, end;
+
+   for (; treeNode; treeNode = treeNode->getSibling())
+   {
+      switch(treeNode->getNodeKind())
       {
-	 // this will put the result in v0
-         generateSpim(node->getChild(0));
+         case DeclKind:
+            // the locals already have slots
+            break;
+         case StmtKind:
+            switch(treeNode->getStmt())
+            {
+               case ReturnStmt:
+                  writeReturn(treeNode);
+                  break;
+               case WhileStmt:
+                  // the number is taken before the body is generated so
+                  // that nested loops get their own labels
+                  labelNum = loopNum++;
+                  top = function->newLabel(LoopLabel, labelNum);
+                  end = function->newLabel(LoopEndLabel, labelNum);
+                  // The test is at the bottom, so an iteration only takes
+                  // the branch back to the top. A copy of it at the top
+                  // skips the loop when it doesn't run at all.
+                  generateCondition(treeNode->getChild(0), end, false);
+                  function->emitLabel(top);
+                  generateSpim(treeNode->getChild(1));
+                  generateCondition(treeNode->getChild(0), top, true);
+                  function->emitLabel(end);
+                  break;
+               case IfStmt:
+                  if (ifConvert && canSelect(treeNode))
+                  {
+                     generateSelect(treeNode);
+                     break;
+                  }
+                  labelNum = loopNum++;
+                  top = function->newLabel(ElseLabel, labelNum);
+                  end = function->newLabel(EndIfLabel, labelNum);
+                  generateCondition(treeNode->getChild(0), top, false);
+                  generateSpim(treeNode->getChild(1));
+                  function->emitJump(end);
+                  function->emitLabel(top);
+                  generateSpim(treeNode->getChild(2));
+                  function->emitLabel(end);
+                  break;
+               case CmpStmt:
+               case ExpStmt:
+                  generateSpim(treeNode->getChild(0));
+                  break;
+               case FuncStmt:
+                  // child 0 starts with the local declarations when there
+                  // are any, and then the statements are in child 1
+                  generateSpim(treeNode->getChild(0));
+                  generateSpim(treeNode->getChild(1));
+                  break;
+               default:
+                  break;
+            }
+            break;
+         case ExpKind:
+            // the value of an expression statement isn't used
+            generateExpression(treeNode, 0);
+            break;
       }
    }
-   outputFile << "   j " << exitJumpString  <<  endl;
 }
 
-void CodeGenerator::printReg(int r)
+void CodeGenerator::writeReturn(ParseNode *node)
 {
-   switch (r)
+   if (node->getChild(0) && generateTailCall(node->getChild(0)))
+      return;
+   if (node->getChild(0))
    {
-      case 0:
-         outputFile << "zero";
-         break;
-      case 1:
-         outputFile << "v0";
-         break;
-      case 2:
-         outputFile << "v1";
-         break;
-      case 3:
-         outputFile << "a0";
-         break;
-      case 4:
-         outputFile << "a1";
-         break;
-      case 5:
-         outputFile << "a2";
-         break;
-      case 6:
-         outputFile << "a3";
-         break;
-      case 7:
-         outputFile << "t0";
-         break;
-      case 8:
-         outputFile << "t1";
-         break;
-      case 9:
-         outputFile << "t2";
-         break;
-      case 10:
-         outputFile << "t3";
-         break;
-      case 11:
-         outputFile << "t4";
+      generateExpression(node->getChild(0), 0);
+      function->emit(mov, v0, stackReg(0), zero);
+   }
+   function->emitJump(exitLabel);
+}
+
+void CodeGenerator::generateExpression(ParseNode *node, unsigned int depth)
+{
+   Reg result = stackReg(depth);
+   int value;
+
+   // an operator on constants is worked out here instead
+   if (InstructionSelector::isConstant(node, value))
+   {
+      loadConstant(result, value);
+      return;
+   }
+
+   switch (node->getExp())
+   {
+      case NumExp:
+         loadConstant(result, node->getNum());
          break;
-      case 12:
-         outputFile << "t5";
+      case VarExp:
+         // an array without an index is passed by its address
+         if (node->getType() == Array)
+            generateAddress(node, depth);
+         else if (findSavedElement(node) >= 0)
+            function->emitMem(lw, result, SlotAddress, zero,
+                              findSavedElement(node), 0);
+         else if (isDirect(node))
+            accessVariable(lw, result, node);
+         else
+         {
+            generateAddress(node, depth);
+            function->emitMem(lw, result, RegAddress, result, 0, 0);
+         }
          break;
-      case 13:
-         outputFile << "t6";
+      case CallExp:
+         generateCall(node, depth);
          break;
-      case 14:
-         outputFile << "t7";
+      case AssignExp:
+         generateAssignment(node, depth);
          break;
-      case 15:
-         outputFile << "t8";
+      case OpExp:
+      case RelExp:
+         generateOperator(node, depth);
          break;
-      case 16:
-         outputFile << "t9";
+   }
+}
+
+void CodeGenerator::generateOperator(ParseNode *node, unsigned int depth)
+{
+   Reg result = stackReg(depth);
+   Reg left, right;
+   int imm;
+   const SelectPattern &pattern = selector.select(node, imm);
+   Opcode op = (Opcode)pattern.op;
+
+   // a value that might not be used wraps around instead of trapping
+   if (speculating && op == add)
+      op = addu;
+   else if (speculating && op == sub)
+      op = subu;
+
+   switch (pattern.shape)
+   {
+      case ImmRight:
+         generateExpression(node->getChild(0), depth);
+         function->emitImm(op, result, result, imm);
          break;
-      case 17:
-         outputFile << "s0";
+      case ImmLeft:
+         generateExpression(node->getChild(1), depth);
+         function->emitImm(op, result, result, imm);
          break;
-      case 18:
-         outputFile << "s1";
+      case ZeroLeft:
+         generateExpression(node->getChild(1), depth);
+         function->emit(op, result, zero, result);
          break;
-      case 19:
-         outputFile << "s2";
+      case ReducedRight:
+         generateExpression(node->getChild(0), depth);
+         if (pattern.op == dvd)
+            divideConstant(result, imm);
+         else
+            multiplyConstant(result, imm);
          break;
-      case 20:
-         outputFile << "s3";
+      case ReducedLeft:
+         generateExpression(node->getChild(1), depth);
+         multiplyConstant(result, imm);
          break;
-      case 21:
-         outputFile << "s4";
+      case SwappedOperands:
+         generateOperands(node, depth, left, right);
+         function->emit(op, result, right, left);
          break;
-      case 22:
-         outputFile << "s5";
+      default:
+         generateOperands(node, depth, left, right);
+         function->emit(op, result, left, right);
          break;
-      case 23:
-         outputFile << "s6";
+   }
+}
+
+void CodeGenerator::loadConstant(Reg r, int value)
+{
+   // a constant that doesn't fit in an immediate is put together from its
+   // halves
+   if (InstructionSelector::isImmediate(value))
+      function->emitImm(li, r, zero, value);
+   else
+   {
+      function->emitImm(lui, r, zero, (value >> 16) & 0xffff);
+      if (value & 0xffff)
+         function->emitImm(ori, r, r, value & 0xffff);
+   }
+}
+
+void CodeGenerator::multiplyConstant(Reg r, int value)
+{
+   vector<ShiftTerm> terms;
+   Reg s = SCRATCHREG;
+
+   if (value == 0)
+   {
+      function->emitImm(li, r, zero, 0);
+      return;
+   }
+   // The terms are worked in from the biggest shift down, so that each
+   // one only shifts what there is so far by the distance to the next.
+   // 10x is ((x << 2) + x) << 1.
+   InstructionSelector::findShiftTerms(value, terms);
+   if (terms.size() == 1)
+   {
+      if (terms[0].shift > 0)
+         function->emitImm(sll, r, r, terms[0].shift);
+   }
+   else
+   {
+      function->emitImm(sll, s, r, terms[0].shift-terms[1].shift);
+      for (unsigned int k=1; k+1<terms.size(); ++k)
+      {
+         function->emit(terms[k].negative ? subu : addu, s, s, r);
+         function->emitImm(sll, s, s, terms[k].shift-terms[k+1].shift);
+      }
+      if (terms.back().shift > 0)
+      {
+         function->emit(terms.back().negative ? subu : addu, s, s, r);
+         function->emitImm(sll, r, s, terms.back().shift);
+      }
+      else
+         function->emit(terms.back().negative ? subu : addu, r, s, r);
+   }
+   if (value < 0)
+      function->emit(subu, r, zero, r);
+}
+
+void CodeGenerator::divideConstant(Reg r, int value)
+{
+   Reg s = SCRATCHREG;
+   int n = InstructionSelector::powerOfTwo(value);
+   int multiplier, shift;
+
+   // A shift rounds down, so a negative dividend has 2^n-1 added first to
+   // make the quotient round toward 0 like div. The sign bits give that
+   // when they are shifted down.
+   if (n > 0)
+   {
+      if (n == 1)
+         function->emitImm(srl, s, r, 31);
+      else
+      {
+         function->emitImm(sra, s, r, 31);
+         function->emitImm(srl, s, s, 32-n);
+      }
+      function->emit(addu, r, r, s);
+      function->emitImm(sra, r, r, n);
+   }
+   if (n >= 0)
+   {
+      if (value < 0)
+         function->emit(subu, r, zero, r);
+      return;
+   }
+
+   // the high word of the product with the magic number is the quotient,
+   // once it is shifted and has 1 added when it is negative
+   InstructionSelector::findMagic(value, multiplier, shift);
+   loadConstant(s, multiplier);
+   function->emit(mulhi, s, r, s);
+   if (value > 0 && multiplier < 0)
+      function->emit(addu, s, s, r);
+   else if (value < 0 && multiplier > 0)
+      function->emit(subu, s, s, r);
+   if (shift > 0)
+      function->emitImm(sra, s, s, shift);
+   function->emitImm(srl, r, s, 31);
+   function->emit(addu, r, s, r);
+}
+
+void CodeGenerator::generateCall(ParseNode *node, unsigned int depth)
+{
+   Reg result = stackReg(depth);
+   int numArguments;
+
+   if (node->getSymbol() == table->getInput())
+   {
+      function->emitImm(li, v0, zero, 5);
+      function->emit(scall, zero, zero, zero);
+      function->emit(mov, result, v0, zero);
+      return;
+   }
+   if (node->getSymbol() == table->getOutput())
+   {
+      generateExpression(node->getChild(0), depth);
+      function->emit(mov, a0, result, zero);
+      function->emitImm(li, v0, zero, 1);
+      function->emit(scall, zero, zero, zero);
+      return;
+   }
+
+   numArguments = generateArguments(node, depth, false);
+   if (numArguments > NUMARGREGS)
+      numArguments = NUMARGREGS;
+   function->emitCall(node->getSymbol(), numArguments);
+   function->emit(mov, result, v0, zero);
+}
+
+bool CodeGenerator::generateTailCall(ParseNode *node)
+{
+   bool self = node->getSymbol() == function->getSymbol();
+   ParseNode *arg;
+   int numArguments = 0;
+
+   if (node->getExp() != CallExp || node->getSymbol() == table->getInput() ||
+       node->getSymbol() == table->getOutput())
+      return false;
+   // the stack arguments of another function would have to go in this
+   // function's caller's frame, which might not have room for them, and a
+   // local array that is passed goes away with the frame
+   for (arg = node->getChild(0); arg; arg = arg->getSibling())
+   {
+      if (isLocalArray(arg))
+         return false;
+      ++numArguments;
+   }
+   if (!self && numArguments > NUMARGREGS)
+      return false;
+
+   // a call to this function starts it over in the same frame
+   generateArguments(node, 0, self);
+   if (self)
+      function->emitJump(entryLabel);
+   else
+      function->emitTailCall(node->getSymbol(), numArguments);
+   return true;
+}
+
+int CodeGenerator::generateArguments(ParseNode *node, unsigned int depth,
+                                     bool self)
+{
+   Reg result = stackReg(depth);
+   ParseNode *arg;
+   int numArguments = 0;
+   int lastCall = 0;
+
+   // an argument that makes a call changes the argument registers and the
+   // stack arguments, so the arguments before the last such argument wait
+   // in temporary slots until it is done
+   for (arg = node->getChild(0); arg; arg = arg->getSibling())
+   {
+      if (registersNeeded(arg) >= CALLNEEDS)
+         lastCall = numArguments;
+      ++numArguments;
+   }
+   // the stack arguments of a call to this function replace parameters
+   // that the arguments might read, so every argument waits
+   if (self && numArguments > NUMARGREGS)
+      lastCall = numArguments;
+   else if (numArguments > NUMARGREGS)
+      function->reserveArguments(numArguments-NUMARGREGS);
+
+   // The first arguments go in $a0 through $a3 and the rest go in order
+   // at the bottom of the frame, which is the top of the callee's frame.
+   // Nothing below depth is in use, since a call changes every $t
+   // register.
+   numArguments = 0;
+   for (arg = node->getChild(0); arg; arg = arg->getSibling())
+   {
+      generateExpression(arg, depth);
+      if (numArguments < lastCall)
+         pushTemp(result);
+      else
+         passArgument(result, numArguments, self);
+      ++numArguments;
+   }
+   for (int a=lastCall; a>0; --a)
+   {
+      popTemp(result);
+      passArgument(result, a-1, self);
+   }
+   return numArguments;
+}
+
+void CodeGenerator::passArgument(Reg r, int argument, bool self)
+{
+   if (argument < NUMARGREGS)
+      function->emit(mov, (Reg)(a0+argument), r, zero);
+   else if (self)
+      function->emitMem(sw, r, SlotAddress, zero, paramSlots[argument], 0);
+   else
+      function->emitMem(sw, r, RegAddress, sp, 0, 4*(argument-NUMARGREGS));
+}
+
+void CodeGenerator::generateAssignment(ParseNode *node, unsigned int depth)
+{
+   ParseNode *var = node->getChild(0);
+   ParseNode *value = node->getChild(1);
+   Reg result = stackReg(depth);
+
+   // the value of the assignment is left in the result register
+   if (isDirect(var))
+   {
+      generateExpression(value, depth);
+      accessVariable(sw, result, var);
+      return;
+   }
+
+   // the address is worked out first and waits while the value is
+   generateAddress(var, depth);
+   if (fits(value, depth+1))
+   {
+      generateExpression(value, depth+1);
+      function->emitMem(sw, stackReg(depth+1), RegAddress, result, 0, 0);
+      function->emit(mov, result, stackReg(depth+1), zero);
+   }
+   else
+   {
+      pushTemp(result);
+      generateExpression(value, depth);
+      popTemp(stackReg(depth+1));
+      function->emitMem(sw, result, RegAddress, stackReg(depth+1), 0, 0);
+   }
+}
+
+void CodeGenerator::generateOperands(ParseNode *node, unsigned int depth,
+                                     Reg &left, Reg &right)
+{
+   ParseNode *first = node->getChild(0);
+   ParseNode *second = node->getChild(1);
+   bool swapped = false;
+
+   // The side that needs more registers goes first, so that its result
+   // only takes up one of them while the other side is worked out. That
+   // can only be done when neither side changes anything.
+   if (registersNeeded(second) > registersNeeded(first) &&
+       !hasSideEffects(first) && !hasSideEffects(second))
+   {
+      first = node->getChild(1);
+      second = node->getChild(0);
+      swapped = true;
+   }
+
+   generateExpression(first, depth);
+   if (fits(second, depth+1))
+   {
+      generateExpression(second, depth+1);
+      left = stackReg(depth);
+      right = stackReg(depth+1);
+   }
+   else
+   {
+      // the first result waits in the frame while the second side uses
+      // the registers, or makes a call that would change them
+      pushTemp(stackReg(depth));
+      generateExpression(second, depth);
+      popTemp(stackReg(depth+1));
+      left = stackReg(depth+1);
+      right = stackReg(depth);
+   }
+   if (swapped)
+   {
+      Reg r = left;
+      left = right;
+      right = r;
+   }
+}
+
+void CodeGenerator::generateCondition(ParseNode *node, int label, bool when)
+{
+   Opcode branch;
+   Reg left, right;
+   int value;
+
+   // a constant condition either always jumps or never does
+   if (InstructionSelector::isConstant(node, value))
+   {
+      if ((value != 0) == when)
+         function->emitJump(label);
+      return;
+   }
+   if (!node->isRelOp())
+   {
+      generateExpression(node, 0);
+      function->emitBranch(when ? bnez : beqz, stackReg(0), zero, label);
+      return;
+   }
+
+   switch (node->getTokenType())
+   {
+      case LT:
+         branch = blt;
          break;
-      case 24:
-         outputFile << "s7";
+      case LEQ:
+         branch = ble;
          break;
-      case 25:
-         outputFile << "sp";
+      case GT:
+         branch = bgt;
          break;
-      case 26:
-         outputFile << "fp";
+      case GEQ:
+         branch = bge;
          break;
-      case 27:
-         outputFile << "ra";
+      case EQ:
+         branch = beq;
          break;
       default:
+         branch = bne;
          break;
+   }
+   if (!when)
+      branch = invertBranch(branch);
+
+   // a comparison with 0 only needs the other side in a register
+   if (InstructionSelector::isConstant(node->getChild(1), value) && value == 0)
+   {
+      generateExpression(node->getChild(0), 0);
+      function->emitBranch(zeroBranch(branch), stackReg(0), zero, label);
+      return;
+   }
+   if (InstructionSelector::isConstant(node->getChild(0), value) && value == 0)
+   {
+      generateExpression(node->getChild(1), 0);
+      function->emitBranch(zeroBranch(swapBranch(branch)), stackReg(0), zero, label);
+      return;
+   }
+   generateOperands(node, 0, left, right);
+   function->emitBranch(branch, left, right, label);
+}
+
+bool CodeGenerator::canSelect(ParseNode *node)
+{
+   vector<ParseNode *> assignments;
+   int value;
+
+   // a constant condition is left to generateCondition, which drops the
+   // arm that can't run
+   if (InstructionSelector::isConstant(node->getChild(0), value))
+      return false;
+   if (!findSelects(node->getChild(1), assignments) ||
+       !findSelects(node->getChild(2), assignments) ||
+       assignments.empty() || assignments.size() > MAXSELECTS)
+      return false;
+   // each value is worked out above the condition in $t0
+   for (unsigned int a=0; a<assignments.size(); ++a)
+   {
+      if (!fits(assignments[a]->getChild(1), 1) ||
+          !isSafe(assignments[a]->getChild(1), node->getChild(0), assignments))
+         return false;
+   }
+   return true;
+}
+
+bool CodeGenerator::findSelects(ParseNode *node,
+                                vector<ParseNode *> &assignments)
+{
+   for (; node; node = node->getSibling())
+   {
+      if (node->getNodeKind() == StmtKind &&
+          (node->getStmt() == CmpStmt || node->getStmt() == ExpStmt))
+      {
+         if (!findSelects(node->getChild(0), assignments))
+            return false;
+      }
+      else if (node->getNodeKind() == ExpKind &&
+               node->getExp() == AssignExp && !node->getChild(0)->getChild(0))
+         assignments.push_back(node);
+      else
+         return false;
+   }
+   return true;
+}
+
+bool CodeGenerator::isSafe(ParseNode *node, ParseNode *cond,
+                           vector<ParseNode *> &assignments)
+{
+   ParseNode *index;
+   int value;
+
+   if (InstructionSelector::isConstant(node, value))
+      return true;
+   switch (node->getExp())
+   {
+      case NumExp:
+         return true;
+      case VarExp:
+         // A scalar can always be loaded, and so can an element at a
+         // constant index of an array in the frame or the data segment.
+         // Any other element might be outside its array, unless the
+         // condition loads the same one before anything changes.
+         index = node->getChild(0);
+         if (!index || (index->isNum() &&
+             table->getEntry(node->getSymbol()).getParamNum() == NOTPARAM))
+            return true;
+         if (hasSideEffects(cond) || !readsSame(cond, node))
+            return false;
+         for (unsigned int a=0; a<assignments.size(); ++a)
+         {
+            if (mentions(index, assignments[a]->getChild(0)->getSymbol()))
+               return false;
+         }
+         return true;
+      case OpExp:
+         // a division might be by zero. A sum or difference is worked out
+         // with addu or subu, which never trap.
+         if (node->getTokenType() == DIV &&
+             !(InstructionSelector::isConstant(node->getChild(1), value) &&
+               value != 0))
+            return false;
+         return isSafe(node->getChild(0), cond, assignments) &&
+                isSafe(node->getChild(1), cond, assignments);
+      case RelExp:
+         return isSafe(node->getChild(0), cond, assignments) &&
+                isSafe(node->getChild(1), cond, assignments);
+      default:
+         return false;
+   }
+}
+
+bool CodeGenerator::readsSame(ParseNode *tree, ParseNode *expression)
+{
+   for (; tree; tree = tree->getSibling())
+   {
+      if (sameExpression(tree, expression))
+         return true;
+      for (int c=0; c<MAXCHILDREN; ++c)
+      {
+         if (readsSame(tree->getChild(c), expression))
+            return true;
+      }
+   }
+   return false;
+}
+
+bool CodeGenerator::sameExpression(ParseNode *a, ParseNode *b)
+{
+   if (!a || !b)
+      return a == b;
+   if (a->getNodeKind() != ExpKind || b->getNodeKind() != ExpKind ||
+       a->getExp() != b->getExp())
+      return false;
+   switch (a->getExp())
+   {
+      case NumExp:
+         return a->getNum() == b->getNum();
+      case VarExp:
+         return a->getSymbol() == b->getSymbol() &&
+                sameExpression(a->getChild(0), b->getChild(0));
+      case OpExp:
+      case RelExp:
+         return a->getTokenType() == b->getTokenType() &&
+                sameExpression(a->getChild(0), b->getChild(0)) &&
+                sameExpression(a->getChild(1), b->getChild(1));
+      default:
+         return false;
+   }
+}
 
+bool CodeGenerator::mentions(ParseNode *node, unsigned int symbol)
+{
+   if (!node)
+      return false;
+   if (node->getNodeKind() == ExpKind && node->getExp() == VarExp &&
+       node->getSymbol() == symbol)
+      return true;
+   for (int c=0; c<MAXCHILDREN; ++c)
+   {
+      for (ParseNode *child = node->getChild(c); child;
+           child = child->getSibling())
+      {
+         if (mentions(child, symbol))
+            return true;
+      }
+   }
+   return false;
+}
+
+void CodeGenerator::generateSelect(ParseNode *node)
+{
+   vector<ParseNode *> assignments;
+   ParseNode *value;
+   Opcode move;
+
+   // An element that the condition loads and an arm assigns is loaded
+   // first and kept in a slot. canSelect made sure that nothing before
+   // the condition's load can change which element it is.
+   findSelects(node->getChild(1), assignments);
+   findSelects(node->getChild(2), assignments);
+   for (unsigned int a=0; a<assignments.size(); ++a)
+   {
+      value = assignments[a]->getChild(1);
+      if (value->getExp() != VarExp || isDirect(value) ||
+          findSavedElement(value) >= 0 || !readsSame(node->getChild(0), value))
+         continue;
+      generateExpression(value, 0);
+      savedElements.push_back(value);
+      savedSlots.push_back(function->newSlot(LocalSlot, 1));
+      function->emitMem(sw, stackReg(0), SlotAddress, zero, savedSlots.back(), 0);
+   }
+
+   move = generateTest(node->getChild(0));
+   generateSelects(node->getChild(1), move);
+   generateSelects(node->getChild(2), (move == movn) ? movz : movn);
+   savedElements.clear();
+   savedSlots.clear();
+}
+
+Opcode CodeGenerator::generateTest(ParseNode *node)
+{
+   ParseNode *first = node->getChild(0);
+   ParseNode *second = node->getChild(1);
+   Reg result = stackReg(0);
+   Reg left, right;
+   int value;
+   bool swapped;
+
+   if (!node->isRelOp())
+   {
+      generateExpression(node, 0);
+      return movn;
    }
+
+   // two sides are equal when their xor is 0, and a side that is 0
+   // already is the test
+   if (node->getTokenType() == EQ || node->getTokenType() == NOTEQ)
+   {
+      if (InstructionSelector::isConstant(second, value) && value == 0)
+         generateExpression(first, 0);
+      else if (InstructionSelector::isConstant(first, value) && value == 0)
+         generateExpression(second, 0);
+      else
+      {
+         generateOperands(node, 0, left, right);
+         function->emit(eor, result, left, right);
+      }
+      return (node->getTokenType() == EQ) ? movz : movn;
+   }
+
+   // a > b is b < a, and a <= b and a >= b are the opposite of a > b and
+   // a < b, so every comparison is one slt
+   swapped = node->getTokenType() == GT || node->getTokenType() == LEQ;
+   if (swapped)
+   {
+      first = node->getChild(1);
+      second = node->getChild(0);
+   }
+   if (InstructionSelector::isConstant(second, value) &&
+       InstructionSelector::isImmediate(value))
+   {
+      generateExpression(first, 0);
+      function->emitImm(slti, result, result, value);
+   }
+   else
+   {
+      generateOperands(node, 0, left, right);
+      if (swapped)
+         function->emit(slt, result, right, left);
+      else
+         function->emit(slt, result, left, right);
+   }
+   if (node->getTokenType() == LT || node->getTokenType() == GT)
+      return movn;
+   return movz;
 }
+
+void CodeGenerator::generateSelects(ParseNode *node, Opcode move)
+{
+   for (; node; node = node->getSibling())
+   {
+      if (node->getNodeKind() == StmtKind)
+      {
+         generateSelects(node->getChild(0), move);
+         continue;
+      }
+      // the variable is loaded so that it keeps its value when the move
+      // isn't made
+      speculating = true;
+      generateExpression(node->getChild(1), 1);
+      speculating = false;
+      accessVariable(lw, stackReg(2), node->getChild(0));
+      function->emit(move, stackReg(2), stackReg(1), stackReg(0));
+      accessVariable(sw, stackReg(2), node->getChild(0));
+   }
+}
+
+int CodeGenerator::findSavedElement(ParseNode *node)
+{
+   for (unsigned int e=0; e<savedElements.size(); ++e)
+   {
+      if (sameExpression(savedElements[e], node))
+         return savedSlots[e];
+   }
+   return -1;
+}
+
+void CodeGenerator::generateAddress(ParseNode *node, unsigned int depth)
+{
+   Entry &entry = table->getEntry(node->getSymbol());
+   ParseNode *index = node->getChild(0);
+   Reg result = stackReg(depth);
+   Reg base = result;
+   int offset = 0;
+   int baseSlot = findBaseSlot(node->getSymbol());
+
+   // a variable index is scaled to bytes before the base is loaded into
+   // the next register
+   if (index && !index->isNum())
+   {
+      generateExpression(index, depth);
+      function->emitImm(sll, result, result, 2);
+      base = stackReg(depth+1);
+   }
+   else if (index)
+      offset = 4*index->getNum();
+
+   if (entry.getParamNum() != NOTPARAM || baseSlot >= 0)
+   {
+      // an array parameter holds the address of the array, and so does
+      // the base slot of an array
+      if (baseSlot < 0)
+         baseSlot = entry.getSlot();
+      function->emitMem(lw, base, SlotAddress, zero, baseSlot, 0);
+      if (offset != 0)
+         function->emitImm(addiu, base, base, offset);
+   }
+   else if (entry.getScope() == 0)
+      function->emitMem(la, base, GlobalAddress, zero, node->getSymbol(), offset);
+   else
+      function->emitMem(la, base, SlotAddress, zero, entry.getSlot(), offset);
+
+   if (base != result)
+      function->emit(add, result, base, result);
+}
+
+bool CodeGenerator::isLocalArray(ParseNode *node)
+{
+   if (node->getExp() != VarExp || node->getType() != Array)
+      return false;
+   Entry &entry = table->getEntry(node->getSymbol());
+   return entry.getScope() != 0 && entry.getParamNum() == NOTPARAM;
+}
+
+bool CodeGenerator::isDirect(ParseNode *node)
+{
+   Entry &entry = table->getEntry(node->getSymbol());
+
+   // an element of an array parameter is only reached through the
+   // address that the parameter holds
+   if (!node->getChild(0))
+      return true;
+   return node->getChild(0)->isNum() && entry.getParamNum() == NOTPARAM;
+}
+
+void CodeGenerator::accessVariable(Opcode op, Reg r, ParseNode *node)
+{
+   Entry &entry = table->getEntry(node->getSymbol());
+   int offset = 0;
+
+   if (node->getChild(0))
+      offset = 4*node->getChild(0)->getNum();
+
+   // an element of an array outside the small data is reached from its
+   // base address when that is kept in a slot
+   if (entry.getScope() == 0 && entry.getMem() == NOTSMALL &&
+       node->getChild(0) && findBaseSlot(node->getSymbol()) >= 0)
+   {
+      function->emitMem(lw, SCRATCHREG, SlotAddress, zero,
+                        findBaseSlot(node->getSymbol()), 0);
+      function->emitMem(op, r, RegAddress, SCRATCHREG, 0, offset);
+   }
+   else if (entry.getScope() == 0)
+      function->emitMem(op, r, GlobalAddress, zero, node->getSymbol(), offset);
+   else
+      function->emitMem(op, r, SlotAddress, zero, entry.getSlot(), offset);
+}
+
+int CodeGenerator::registersNeeded(ParseNode *node)
+{
+   int left, right;
+   int imm;
+   unsigned char shape;
+   ParseNode *index;
+
+   switch (node->getExp())
+   {
+      case VarExp:
+         // a variable index needs a second register for the base
+         index = node->getChild(0);
+         if (node->getType() == Array || !index || index->isNum())
+            return 1;
+         left = registersNeeded(index);
+         return (left > 2) ? left : 2;
+      case CallExp:
+         return CALLNEEDS;
+      case AssignExp:
+         right = registersNeeded(node->getChild(1));
+         if (isDirect(node->getChild(0)))
+            return right;
+         node = node->getChild(0)->getChild(0);
+         left = node->isNum() ? 1 : registersNeeded(node);
+         if (left < 2)
+            left = 2;
+         return (left > right+1) ? left : right+1;
+      case OpExp:
+      case RelExp:
+         // a constant that goes in the instruction or is reduced doesn't
+         // need a register
+         if (InstructionSelector::isConstant(node, imm))
+            return 1;
+         shape = selector.select(node, imm).shape;
+         if (shape == ImmRight || shape == ReducedRight)
+            return registersNeeded(node->getChild(0));
+         if (shape == ImmLeft || shape == ZeroLeft || shape == ReducedLeft)
+            return registersNeeded(node->getChild(1));
+         // the Sethi-Ullman number: one more than the sides need when they
+         // need the same, otherwise what the bigger side needs
+         left = registersNeeded(node->getChild(0));
+         right = registersNeeded(node->getChild(1));
+         if (left == right)
+            return left+1;
+         return (left > right) ? left : right;
+      default:
+         return 1;
+   }
+}
+
+bool CodeGenerator::hasSideEffects(ParseNode *node)
+{
+   if (!node)
+      return false;
+   if (node->getNodeKind() == ExpKind &&
+       (node->getExp() == CallExp || node->getExp() == AssignExp))
+      return true;
+   return hasSideEffects(node->getChild(0)) ||
+          hasSideEffects(node->getChild(1));
+}
+
+bool CodeGenerator::fits(ParseNode *node, unsigned int depth)
+{
+   // anything with a call in it needs all of the registers
+   return depth + registersNeeded(node) <= NUMSTACKREGS;
+}
+
+Reg CodeGenerator::stackReg(unsigned int depth)
+{
+   return (Reg)(t0 + depth);
+}
+
+void CodeGenerator::pushTemp(Reg r)
+{
+   if (tempDepth == tempSlots.size())
+      tempSlots.push_back(function->newSlot(TempSlot, 1));
+   function->emitMem(sw, r, SlotAddress, zero, tempSlots[tempDepth], 0);
+   ++tempDepth;
+}
+
+void CodeGenerator::popTemp(Reg r)
+{
+   --tempDepth;
+   function->emitMem(lw, r, SlotAddress, zero, tempSlots[tempDepth], 0);
+}
+
 #endif
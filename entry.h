@@ -7,48 +7,74 @@
 #ifndef ENTRY_H
 #define ENTRY_H
 #include <string.h>
-
-#define MAXPARAMS 8
+#include <vector>
 
 class Entry
 {
    public:
-      Entry(ParseNode *node);
+      // the parameter types of a function are appended to paramTypes
+      Entry(ParseNode *node, vector<Type> &paramTypes);
       bool nameMatch(char *s);
       unsigned int getScope(){return scope;}
-      char *getString(void){return name;}
-      Type getType(void){return type;}
-      DeclNode getDeclType(void){return kindOfDecl;}
-      ExpNode getExpType(void) {return exp;}
-      NodeKind getNodeKind(void) {return nodeKind;}
-      Type *getParams(void){return paramList;}
-      void displayEntry(void);
+      const char *getString(void){return name;}
+      Type getType(void){return (Type)type;}
+      DeclNode getDeclType(void){return (DeclNode)kindOfDecl;}
+      ExpNode getExpType(void) {return (ExpNode)exp;}
+      NodeKind getNodeKind(void) {return (NodeKind)nodeKind;}
+      // the parameter types are paramStart through paramStart+params-1
+      // in the symbol table's shared array of parameter types
+      unsigned int getParamStart(void) {return paramStart;}
+      void displayEntry(OutputBuffer &out, Type *paramTypes);
       void setScope(unsigned int s) {scope = s;}
       unsigned int getParamSize(void) {return params;}
-      Type getParam(int i){return paramList[i];}
+      // returns the number of elements of an array, or 0
+      unsigned int getArraySize(void) {return arraySize;}
       void setParamNum(int n){paramNum = n;}
       int getParamNum(void){return paramNum;} 
+      // a global's memory location is its offset from $gp, or NOTSMALL if
+      // it isn't in the small data
       void setMem(int m) {memLocation = m;}
       int getMem(void) {return memLocation;}
+      // a local's slot is its place among the parameters and locals of
+      // its function, which are numbered from 0 in declaration order. A
+      // global's slot is its index in the symbol table.
+      void setSlot(unsigned int s) {slot = s;}
+      unsigned int getSlot(void) {return slot;}
+      // a function's parameters and locals are the numLocals entries
+      // that start at index firstLocal of the symbol table
+      void setLocals(unsigned int first, unsigned int num) {firstLocal = first; numLocals = num;}
+      unsigned int getFirstLocal(void) {return firstLocal;}
+      unsigned int getNumLocals(void) {return numLocals;}
+      // an entry is live while its scope is open
+      void setLive(bool l) {live = l;}
+      bool isLive(void) {return live;}
    private:
-      void setParams(ParseNode *node);
-      char name[STRINGSIZE];
-      DeclNode kindOfDecl;
-      NodeKind nodeKind;
-      Type type;
-      ExpNode exp;
+      void setParams(ParseNode *node, vector<Type> &paramTypes);
+      // the name belongs to the declaration node, which outlives the
+      // symbol table, so it isn't copied
+      const char *name;
+      unsigned char kindOfDecl;
+      unsigned char nodeKind;
+      unsigned char type;
+      unsigned char exp;
+      bool live;
       unsigned int scope;
       unsigned int params;
-      Type paramList[MAXPARAMS];
+      unsigned int paramStart;
       unsigned int arraySize;
       int paramNum;
       int memLocation;
+      unsigned int slot;
+      unsigned int firstLocal;
+      unsigned int numLocals;
 };
 
-Entry::Entry(ParseNode *node)
+Entry::Entry(ParseNode *node, vector<Type> &paramTypes)
 {
-   strcpy(name,node->getString());
+   name = node->getString();
    nodeKind = node->getNodeKind();
+   kindOfDecl = VarDecl;
+   exp = NumExp;
    if (nodeKind == DeclKind)
       kindOfDecl = node->getDeclType();
    else if (nodeKind == ExpKind)
@@ -60,9 +86,14 @@ Entry::Entry(ParseNode *node)
    else
       arraySize = 0;
    params = 0;
-   setParams(node);
+   paramStart = paramTypes.size();
+   setParams(node, paramTypes);
    paramNum = node->getParamNum();
    memLocation = node->getMem();
+   slot = 0;
+   firstLocal = 0;
+   numLocals = 0;
+   live = true;
 }
 
 bool Entry::nameMatch(char *s)
@@ -73,7 +104,7 @@ bool Entry::nameMatch(char *s)
       return false;
 }
 
-void Entry::setParams(ParseNode *node)
+void Entry::setParams(ParseNode *node, vector<Type> &paramTypes)
 {
    ParseNode *tmp=NULL;
 
@@ -83,51 +114,38 @@ void Entry::setParams(ParseNode *node)
       while (tmp)
       {
          ++params;
-         if (params > MAXPARAMS)
-         {
-            cerr << "Function Parameter Limit (" <<  MAXPARAMS;
-            cerr << ") Exceeded in Declaration of: ";
-            cerr << name << endl;
-            exit(EXIT_FAILURE);
-         }
-         else
-         {
-            paramList[params-1] = tmp->getType();
-            tmp = tmp->getSibling();
-         }
+         paramTypes.push_back(tmp->getType());
+         tmp = tmp->getSibling();
       }
    }  
    else 
       return;
 }
 
-void Entry::displayEntry()
+void Entry::displayEntry(OutputBuffer &out, Type *paramTypes)
 {
-   cout << ParseNode::NODE_TYPE[nodeKind] << " ";
+   out << ParseNode::NODE_TYPE[nodeKind] << " ";
    if (nodeKind == DeclKind)
-      cout << ParseNode::DECL_TYPE[kindOfDecl] << " ";
+      out << ParseNode::DECL_TYPE[kindOfDecl] << " ";
    else if (nodeKind == ExpKind)
-      cout << ParseNode::EXPR_TYPE[exp] << " ";
+      out << ParseNode::EXPR_TYPE[exp] << " ";
    
-   cout << ParseNode::TYPE_TYPE[type] << " " << name;
-   cout << " Scope = " << scope << " ";
+   out << ParseNode::TYPE_TYPE[type] << " " << name;
+   out << " Scope = " << scope << " ";
 
    if (params > 0)
    {
-      cout << "Number of Parameters: " << params;
-      cout << endl << "   ";
-      cout << "Parameter Types: ";
+      out << "Number of Parameters: " << params;
+      out << '\n' << "   ";
+      out << "Parameter Types: ";
       for (unsigned int i=0;i<params;++i)
-         cout << ParseNode::TYPE_TYPE[paramList[i]] << " ";
+         out << ParseNode::TYPE_TYPE[paramTypes[paramStart+i]] << " ";
    }
    
    if (type == Array && kindOfDecl == VarDecl )
-      cout << "Array Size: " << arraySize;
+      out << "Array Size: " << arraySize;
 
-   cout << endl;
+   out << '\n';
 }
 
 #endif
-
-
-
@@ -0,0 +1,608 @@
+// By: David Karhi
+//
+//   This is the header file for the machine code that the code generator
+//   builds before any assembly is written. A function's code is a list of
+//   Instructions. Each one is an Opcode with Reg operands, an immediate,
+//   and a target that is a label, a frame slot or a symbol depending on
+//   the opcode. Frame slots don't get offsets until the whole function is
+//   known, so passes can add, remove and move them. Once the code is
+//   finished it is split into basic blocks for the passes that need them.
+//
+
+#ifndef MACHINECODE_H
+#define MACHINECODE_H
+
+#include <vector>
+#include "parsenode.h"
+
+// These are the MIPS instructions that the code generator uses. Names
+// that the standard library already uses are shortened (mov for move,
+// dvd for div, jmp for j). place marks where a label goes. jt is a tail
+// call, which jumps to a function that returns in place of this one.
+// mulhi is a mult followed by a mfhi, which keeps the high word. movz and
+// movn only write rd when rt is zero or isn't, so they read rd as well.
+// eor is xor. addu and subu wrap around where add and sub would trap on
+// overflow. The branches from bltz to bgtz compare one register with 0.
+typedef enum {lw,sw,add,sub,jr,jl,li,scall,mov,
+              addiu,mul,dvd,sll,slt,sle,sgt,sge,seq,sne,la,slti,lui,ori,
+              sra,srl,mulhi,movz,movn,eor,addu,subu,beq,bne,blt,ble,bgt,bge,
+              beqz,bnez,bltz,bgez,blez,bgtz,jmp,place,nop,jt} Opcode;
+
+#define NUMOPCODES 47
+
+// the number of registers in the Reg type
+#define NUM_REGS 29
+
+// This says where the memory operand of a lw, sw or la is. A RegAddress
+// is imm(rs). A SlotAddress is imm bytes into frame slot target. A
+// GlobalAddress is imm bytes into the global whose symbol is target, which
+// is reached from $gp when the global is in the small data.
+typedef enum {NoAddress,RegAddress,SlotAddress,GlobalAddress} AddressMode;
+
+// A global of up to SMALLGLOBAL bytes is put in the small data while that
+// stays within SMALLDATA bytes, which is as far as an offset reaches from
+// $gp. Main points $gp at the start of it.
+#define SMALLGLOBAL 256
+#define SMALLDATA 32768
+
+// Parameters are in the caller's frame, locals and temporaries are in
+// this function's frame. A SaveSlot holds a callee-saved register while
+// the function runs.
+typedef enum {ParamSlot,LocalSlot,TempSlot,SaveSlot} SlotKind;
+
+// the kinds of labels, which decide how a label is named
+typedef enum {LoopLabel,LoopEndLabel,ElseLabel,EndIfLabel,ExitLabel,
+              EntryLabel} LabelKind;
+
+#define NOLABEL -1
+
+// Registers are numbered by the Reg type. The sets of registers in the
+// passes are masks with a bit for each one.
+#define REGBIT(r) (1u << (r))
+// the set of registers from first through last
+#define REGRANGE(first,last) ((REGBIT(last) << 1) - REGBIT(first))
+
+// the first arguments of a call are passed in $a0 through $a3
+#define NUMARGREGS 4
+
+// the registers that a call is allowed to change
+#define CALLER_SAVED (REGRANGE(v0,a3) | REGRANGE(t0,t9) | REGBIT(ra))
+// the registers that a function has to give back the way it found them,
+// along with $ra, which it needs to return
+#define CALLEE_SAVED (REGRANGE(s0,s7) | REGRANGE(fp,ra))
+// the registers that still matter when a function returns
+#define EXIT_LIVE (REGBIT(v0) | REGRANGE(s0,s7) | REGRANGE(sp,ra))
+
+struct Instruction
+{
+   // the Opcode
+   unsigned char op;
+   // the destination and source registers
+   unsigned char rd, rs, rt;
+   // the AddressMode of a memory operand
+   unsigned char mode;
+   // the immediate, or for a call the number of arguments in registers
+   int imm;
+   // a label for branches and jumps, a slot or symbol for memory
+   // operands and the function's symbol for calls
+   int target;
+   // for a call, the registers that the callee might change
+   unsigned int clobbers;
+};
+
+struct FrameSlot
+{
+   // the SlotKind
+   unsigned char kind;
+   // the register that a SaveSlot holds
+   unsigned char reg;
+   // the size in words
+   int words;
+   // the offset from the top of the frame, or from the start of the
+   // static storage of a static function, which is set by layoutFrame
+   int offset;
+};
+
+struct MachineLabel
+{
+   // the LabelKind
+   unsigned char kind;
+   // labels are numbered across the whole program
+   int number;
+};
+
+struct BasicBlock
+{
+   // the block is code[first] through code[last-1]
+   unsigned int first, last;
+   // the block that the end of this block falls into and the block that
+   // its branch or jump goes to, or -1 if there isn't one
+   int fallThrough, branchTo;
+};
+
+class MachineFunction
+{
+   public:
+      // the function that this code is for
+      MachineFunction(unsigned int sym, const char *n);
+      unsigned int getSymbol(void) {return symbol;}
+      const char *getName(void) {return name;}
+
+      // these add one instruction to the end of the code
+      void emit(Opcode op, Reg rd, Reg rs, Reg rt);
+      void emitImm(Opcode op, Reg rd, Reg rs, int imm);
+      // a load or store of register r, or an la into r
+      void emitMem(Opcode op, Reg r, AddressMode mode, Reg base, int target, int offset);
+      void emitBranch(Opcode op, Reg rs, Reg rt, int label);
+      void emitJump(int label);
+      // a call that passes its first args arguments in registers
+      void emitCall(unsigned int sym, int args);
+      // a tail call, which passes all of its arguments in registers
+      void emitTailCall(unsigned int sym, int args);
+      void emitLabel(int label);
+
+      // adds a label of the given kind and returns its number
+      int newLabel(LabelKind kind, int number);
+      MachineLabel &getLabel(int l) {return labels[l];}
+      unsigned int getNumLabels(void) {return labels.size();}
+      // adds a frame slot of the given kind and size and returns its number
+      int newSlot(SlotKind kind, int words);
+      FrameSlot &getSlot(int s) {return slots[s];}
+      unsigned int getNumSlots(void) {return slots.size();}
+      // adds a SaveSlot for r and returns its number
+      int saveRegister(Reg r);
+
+      // makes room at the bottom of the frame for a call that passes
+      // words of arguments on the stack
+      void reserveArguments(int words);
+
+      // A function that is never active twice at once can keep its slots
+      // in static storage, apart from the parameters that come on the
+      // stack. Its frame only holds the arguments that it passes on the
+      // stack.
+      void setStatic(bool s) {staticFrame = s;}
+      bool isStatic(void) {return staticFrame;}
+      // the offset of the static storage from $gp, and its size
+      void setStaticBase(int base) {staticBase = base;}
+      int getStaticBase(void) {return staticBase;}
+      int getStaticSize(void) {return staticSize;}
+      // the registers that a call to the function might change, which are
+      // all of the caller-saved ones until its code is known
+      void setClobbers(unsigned int regs) {clobbers = regs;}
+      unsigned int getClobbers(void) {return clobbers;}
+
+      // gives every slot an offset and works out the size of the frame
+      void layoutFrame(void);
+      int getFrameSize(void) {return frameSize;}
+      // splits the code into basic blocks
+      void findBlocks(void);
+      vector<BasicBlock> &getBlocks(void) {return blocks;}
+      // finds the blocks, then sets liveOut[i] to the registers whose
+      // values are still needed after code[i]
+      void findLiveness(vector<unsigned int> &liveOut);
+
+      // the code, which passes are free to change
+      vector<Instruction> code;
+   private:
+      unsigned int symbol;
+      const char *name;
+      vector<FrameSlot> slots;
+      vector<MachineLabel> labels;
+      vector<BasicBlock> blocks;
+      int frameSize;
+      // the most words of arguments that a call passes on the stack
+      int argumentWords;
+      bool staticFrame;
+      int staticBase, staticSize;
+      unsigned int clobbers;
+};
+
+// returns true if the instruction ends a basic block
+bool endsBlock(const Instruction &i)
+{
+   return (i.op >= beq && i.op <= jmp) || i.op == jr || i.op == jt;
+}
+
+// returns true if the instruction is a branch or jump to a label
+bool jumpsToLabel(const Instruction &i)
+{
+   return i.op >= beq && i.op <= jmp;
+}
+
+// returns true if the instruction is a branch that might not be taken
+bool isConditional(const Instruction &i)
+{
+   return i.op >= beq && i.op <= bgtz;
+}
+
+// returns the branch that is taken when op isn't
+Opcode invertBranch(Opcode op)
+{
+   switch (op)
+   {
+      case beq: return bne;
+      case bne: return beq;
+      case blt: return bge;
+      case bge: return blt;
+      case ble: return bgt;
+      case bgt: return ble;
+      case beqz: return bnez;
+      case bnez: return beqz;
+      case bltz: return bgez;
+      case bgez: return bltz;
+      case blez: return bgtz;
+      default: return blez;
+   }
+}
+
+// returns the branch that tests the same thing as op with its two
+// registers the other way around
+Opcode swapBranch(Opcode op)
+{
+   switch (op)
+   {
+      case blt: return bgt;
+      case bgt: return blt;
+      case ble: return bge;
+      case bge: return ble;
+      default: return op;
+   }
+}
+
+// returns the branch that compares a register with 0 the way that op
+// compares it with another register
+Opcode zeroBranch(Opcode op)
+{
+   switch (op)
+   {
+      case beq: return beqz;
+      case bne: return bnez;
+      case blt: return bltz;
+      case bge: return bgez;
+      case ble: return blez;
+      default: return bgtz;
+   }
+}
+
+// returns the set of registers that the instruction reads
+unsigned int regsRead(const Instruction &i)
+{
+   unsigned int regs = 0;
+
+   switch (i.op)
+   {
+      case add: case sub: case mul: case dvd: case slt: case sle: case sgt:
+      case sge: case seq: case sne: case sw: case beq: case bne: case blt:
+      case ble: case bgt: case bge: case mulhi: case eor: case addu:
+      case subu:
+         regs = REGBIT(i.rs) | REGBIT(i.rt);
+         break;
+      case movz: case movn:
+         // rd keeps its value when the move isn't made
+         regs = REGBIT(i.rd) | REGBIT(i.rs) | REGBIT(i.rt);
+         break;
+      case addiu: case sll: case mov: case slti: case ori: case sra:
+      case srl: case beqz: case bnez: case bltz: case bgez: case blez:
+      case bgtz:
+         regs = REGBIT(i.rs);
+         break;
+      case lw: case la:
+         regs = REGBIT(i.rs);
+         break;
+      case jl:
+         // the argument registers that are passed and the stack
+         regs = REGBIT(sp);
+         if (i.imm > 0)
+            regs |= REGRANGE(a0,a0+i.imm-1);
+         break;
+      case scall:
+         regs = REGBIT(v0) | REGBIT(a0);
+         break;
+      case jr:
+         // the function returns, so everything its caller needs is read
+         regs = REGBIT(i.rs) | EXIT_LIVE;
+         break;
+      case jt:
+         // the callee returns for this function and sets $v0 itself
+         regs = REGBIT(sp) | (EXIT_LIVE & ~REGBIT(v0));
+         if (i.imm > 0)
+            regs |= REGRANGE(a0,a0+i.imm-1);
+         break;
+      default:
+         break;
+   }
+   // a slot is either in the frame or in static storage
+   if (i.mode == SlotAddress)
+      regs |= REGBIT(sp) | REGBIT(gp);
+   else if (i.mode == GlobalAddress)
+      regs |= REGBIT(gp);
+   return regs & ~REGBIT(zero);
+}
+
+// returns the set of registers that the instruction writes
+unsigned int regsWritten(const Instruction &i)
+{
+   switch (i.op)
+   {
+      case add: case sub: case mul: case dvd: case slt: case sle: case sgt:
+      case sge: case seq: case sne: case addiu: case sll: case mov: case li:
+      case lw: case la: case slti: case lui: case ori: case sra: case srl:
+      case mulhi: case movz: case movn: case eor: case addu: case subu:
+         return REGBIT(i.rd) & ~REGBIT(zero);
+      case jl:
+         return i.clobbers;
+      case scall:
+         return REGBIT(v0);
+      default:
+         return 0;
+   }
+}
+
+MachineFunction::MachineFunction(unsigned int sym, const char *n)
+{
+   symbol = sym;
+   name = n;
+   frameSize = 0;
+   argumentWords = 0;
+   staticFrame = false;
+   staticBase = 0;
+   staticSize = 0;
+   clobbers = CALLER_SAVED;
+}
+
+void MachineFunction::emit(Opcode op, Reg rd, Reg rs, Reg rt)
+{
+   Instruction i = {(unsigned char)op, (unsigned char)rd, (unsigned char)rs,
+                    (unsigned char)rt, NoAddress, 0, 0};
+   code.push_back(i);
+}
+
+void MachineFunction::emitImm(Opcode op, Reg rd, Reg rs, int imm)
+{
+   Instruction i = {(unsigned char)op, (unsigned char)rd, (unsigned char)rs,
+                    zero, NoAddress, imm, 0};
+   code.push_back(i);
+}
+
+void MachineFunction::emitMem(Opcode op, Reg r, AddressMode mode, Reg base,
+                              int target, int offset)
+{
+   Instruction i = {(unsigned char)op, zero, (unsigned char)base, zero,
+                    (unsigned char)mode, offset, target};
+
+   // a store reads r, while loads and la write it
+   if (op == sw)
+      i.rt = r;
+   else
+      i.rd = r;
+   code.push_back(i);
+}
+
+void MachineFunction::emitBranch(Opcode op, Reg rs, Reg rt, int label)
+{
+   Instruction i = {(unsigned char)op, zero, (unsigned char)rs,
+                    (unsigned char)rt, NoAddress, 0, label};
+   code.push_back(i);
+}
+
+void MachineFunction::emitJump(int label)
+{
+   Instruction i = {jmp, zero, zero, zero, NoAddress, 0, label};
+   code.push_back(i);
+}
+
+void MachineFunction::emitCall(unsigned int sym, int args)
+{
+   Instruction i = {jl, zero, zero, zero, NoAddress, args, (int)sym,
+                    CALLER_SAVED};
+   code.push_back(i);
+}
+
+void MachineFunction::emitTailCall(unsigned int sym, int args)
+{
+   Instruction i = {jt, zero, zero, zero, NoAddress, args, (int)sym};
+   code.push_back(i);
+}
+
+void MachineFunction::emitLabel(int label)
+{
+   Instruction i = {place, zero, zero, zero, NoAddress, 0, label};
+   code.push_back(i);
+}
+
+int MachineFunction::newLabel(LabelKind kind, int number)
+{
+   MachineLabel l = {(unsigned char)kind, number};
+
+   labels.push_back(l);
+   return labels.size()-1;
+}
+
+int MachineFunction::newSlot(SlotKind kind, int words)
+{
+   FrameSlot s = {(unsigned char)kind, zero, words, 0};
+
+   slots.push_back(s);
+   return slots.size()-1;
+}
+
+int MachineFunction::saveRegister(Reg r)
+{
+   int s = newSlot(SaveSlot, 1);
+
+   slots[s].reg = r;
+   return s;
+}
+
+void MachineFunction::layoutFrame()
+{
+   // the offsets are from the top of the frame, where the caller's stack
+   // pointer was. The parameters are just above it.
+   int used = 0;
+   int param = 0;
+   unsigned int written = 0;
+   vector<bool> referenced(slots.size(), false);
+
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].mode == SlotAddress)
+         referenced[code[i].target] = true;
+      written |= regsWritten(code[i]);
+   }
+
+   // Only the registers that the code changes are saved. A call changes
+   // $ra, so a function that makes no calls keeps its return address there.
+   for (int r=zero; r<=ra; ++r)
+   {
+      if (written & CALLEE_SAVED & REGBIT(r))
+         saveRegister((Reg)r);
+   }
+   referenced.resize(slots.size(), false);
+
+   for (unsigned int i=0; i<slots.size(); ++i)
+   {
+      if (slots[i].kind == ParamSlot)
+      {
+         slots[i].offset = 4*param;
+         ++param;
+      }
+      // a slot that no instruction uses takes no space. The code that
+      // uses a SaveSlot is only added once the frame is known.
+      else if ((referenced[i] || slots[i].kind == SaveSlot) && staticFrame)
+      {
+         slots[i].offset = used;
+         used += 4*slots[i].words;
+      }
+      else if (referenced[i] || slots[i].kind == SaveSlot)
+      {
+         used += 4*slots[i].words;
+         slots[i].offset = -used;
+      }
+   }
+   // the arguments that calls pass on the stack are at the bottom
+   if (staticFrame)
+   {
+      staticSize = used;
+      frameSize = 4*argumentWords;
+   }
+   else
+      frameSize = used + 4*argumentWords;
+}
+
+void MachineFunction::reserveArguments(int words)
+{
+   if (words > argumentWords)
+      argumentWords = words;
+}
+
+void MachineFunction::findBlocks()
+{
+   vector<int> blockOf(labels.size(), -1);
+   BasicBlock b;
+
+   blocks.clear();
+   b.first = 0;
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      // a label starts a new block unless the block is still empty
+      if (code[i].op == place && i > b.first)
+      {
+         b.last = i;
+         blocks.push_back(b);
+         b.first = i;
+      }
+      if (code[i].op == place)
+         blockOf[code[i].target] = blocks.size();
+      if (endsBlock(code[i]))
+      {
+         b.last = i+1;
+         blocks.push_back(b);
+         b.first = i+1;
+      }
+   }
+   if (b.first < code.size())
+   {
+      b.last = code.size();
+      blocks.push_back(b);
+   }
+
+   // now that every label has a block, the edges can be filled in
+   for (unsigned int i=0; i<blocks.size(); ++i)
+   {
+      Instruction &end = code[blocks[i].last-1];
+
+      blocks[i].fallThrough = -1;
+      blocks[i].branchTo = -1;
+      if (!endsBlock(end) || isConditional(end))
+      {
+         if (i+1 < blocks.size())
+            blocks[i].fallThrough = i+1;
+      }
+      if (jumpsToLabel(end))
+         blocks[i].branchTo = blockOf[end.target];
+   }
+}
+
+void MachineFunction::findLiveness(vector<unsigned int> &liveOut)
+{
+   unsigned int n;
+   vector<unsigned int> use, def, in, out;
+   bool changed = true;
+   unsigned int live;
+
+   findBlocks();
+   n = blocks.size();
+   use.assign(n, 0);
+   def.assign(n, 0);
+   in.assign(n, 0);
+   out.assign(n, 0);
+   for (unsigned int b=0; b<n; ++b)
+   {
+      // a register is used by a block if it is read before it is written
+      for (unsigned int i=blocks[b].last; i>blocks[b].first; --i)
+      {
+         use[b] = (use[b] & ~regsWritten(code[i-1])) | regsRead(code[i-1]);
+         def[b] |= regsWritten(code[i-1]);
+      }
+   }
+
+   // the blocks are visited backwards, since that is the way that the
+   // information flows
+   while (changed)
+   {
+      changed = false;
+      for (unsigned int b=n; b>0; --b)
+      {
+         BasicBlock &block = blocks[b-1];
+
+         live = 0;
+         if (block.fallThrough >= 0)
+            live |= in[block.fallThrough];
+         if (block.branchTo >= 0)
+            live |= in[block.branchTo];
+         // the end of the function is where the caller takes over
+         if (block.fallThrough < 0 && block.branchTo < 0)
+            live = EXIT_LIVE;
+         out[b-1] = live;
+         live = use[b-1] | (live & ~def[b-1]);
+         if (live != in[b-1])
+         {
+            in[b-1] = live;
+            changed = true;
+         }
+      }
+   }
+
+   liveOut.assign(code.size(), 0);
+   for (unsigned int b=0; b<n; ++b)
+   {
+      live = out[b];
+      for (unsigned int i=blocks[b].last; i>blocks[b].first; --i)
+      {
+         liveOut[i-1] = live;
+         live = (live & ~regsWritten(code[i-1])) | regsRead(code[i-1]);
+      }
+   }
+}
+
+#endif
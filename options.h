@@ -0,0 +1,47 @@
+// By: David Karhi
+//
+//   This is the header file for the Options struct. It holds everything
+//   that was asked for on the command line so that it can be handed to
+//   the parts of the compiler that need it in one piece.
+//
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstddef>
+
+// the assembly goes here unless -o says otherwise
+#define DEFAULTOUTPUT "output.asm"
+
+struct Options
+{
+   // the C- source file
+   char *inputFile;
+   // where the assembly is written. "-" means standard output.
+   const char *outputFile;
+   // true if debugging information is written to the screen
+   bool debug;
+   // the peephole rules that are used, with a bit for each PeepholeRule
+   unsigned int peepholeRules;
+   // true if variables are kept in registers
+   bool allocateRegisters;
+   // true if small if statements are done with conditional moves
+   bool ifConvert;
+   // true if functions that are never active twice keep their slots in
+   // static storage
+   bool staticFrames;
+   // true if each call only gives up the registers that its callee is
+   // known to change
+   bool callSummaries;
+   // true if the instructions of each block are reordered
+   bool schedule;
+   // true if the code is for a MIPS with branch and load delay slots
+   bool targetDelays;
+
+   Options() {inputFile = NULL; outputFile = DEFAULTOUTPUT; debug = false;
+              peepholeRules = ~0u; allocateRegisters = true;
+              ifConvert = true; staticFrames = true; callSummaries = true;
+              schedule = true; targetDelays = false;}
+};
+
+#endif
@@ -0,0 +1,170 @@
+// By: David Karhi
+//
+//   This is the header file for the OutputBuffer class. An output buffer
+//   collects text in a large block of memory and only writes it out when
+//   the block is full or when it is flushed, so writing a line does not
+//   cost a system call. Numbers are formatted by hand straight into the
+//   buffer.
+//
+
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BUFFERSIZE 65536
+
+class OutputBuffer
+{
+   private:
+      char buffer[BUFFERSIZE];
+      unsigned int length;
+      int fd;
+      // true if we opened fd and have to close it
+      bool ownsFile;
+      // makes sure there is room for n more characters
+      void reserve(unsigned int n) {if (length + n > BUFFERSIZE) flush();}
+   public:
+      // the constructor writes to the given file descriptor, which is
+      // standard output by default
+      OutputBuffer(int f = 1);
+      // the deconstructor flushes the buffer and closes the file
+      ~OutputBuffer();
+      // open the given file for writing. A path of "-" means standard
+      // output. Returns false if the file can't be opened.
+      bool open(const char *path);
+      // writes everything in the buffer to the file
+      void flush(void);
+      // returns the number of characters waiting in the buffer
+      unsigned int size(void) {return length;}
+      // these append text and numbers to the buffer
+      OutputBuffer &operator<<(const char *s);
+      OutputBuffer &operator<<(char c);
+      OutputBuffer &operator<<(int n);
+      OutputBuffer &operator<<(unsigned int n);
+      OutputBuffer &operator<<(double d);
+};
+
+OutputBuffer::OutputBuffer(int f)
+{
+   length = 0;
+   fd = f;
+   ownsFile = false;
+}
+
+OutputBuffer::~OutputBuffer()
+{
+   flush();
+   if (ownsFile)
+      close(fd);
+}
+
+bool OutputBuffer::open(const char *path)
+{
+   flush();
+   if (ownsFile)
+      close(fd);
+   ownsFile = false;
+
+   if (strcmp(path, "-") == 0)
+   {
+      fd = 1;
+      return true;
+   }
+
+   fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return false;
+   ownsFile = true;
+   return true;
+}
+
+void OutputBuffer::flush()
+{
+   unsigned int written = 0;
+   ssize_t n;
+
+   while (written < length)
+   {
+      n = write(fd, buffer + written, length - written);
+      if (n <= 0)
+         break;
+      written += n;
+   }
+   length = 0;
+}
+
+OutputBuffer &OutputBuffer::operator<<(const char *s)
+{
+   unsigned int n = strlen(s);
+   unsigned int part;
+
+   // a long string is copied in as many pieces as it takes
+   while (n > 0)
+   {
+      if (length == BUFFERSIZE)
+         flush();
+      part = BUFFERSIZE - length;
+      if (part > n)
+         part = n;
+      memcpy(buffer + length, s, part);
+      length += part;
+      s += part;
+      n -= part;
+   }
+   return *this;
+}
+
+OutputBuffer &OutputBuffer::operator<<(char c)
+{
+   reserve(1);
+   buffer[length++] = c;
+   return *this;
+}
+
+OutputBuffer &OutputBuffer::operator<<(int n)
+{
+   // the magnitude is done as unsigned so the most negative int works
+   unsigned int magnitude = n;
+
+   reserve(11);
+   if (n < 0)
+   {
+      buffer[length++] = '-';
+      magnitude = 0u - magnitude;
+   }
+   return *this << magnitude;
+}
+
+OutputBuffer &OutputBuffer::operator<<(unsigned int n)
+{
+   char digits[10];
+   int i = 0;
+
+   // the digits come out backwards, so they are reversed on the way in
+   do
+   {
+      digits[i++] = '0' + n % 10;
+      n /= 10;
+   }
+   while (n > 0);
+
+   reserve(i);
+   while (i > 0)
+      buffer[length++] = digits[--i];
+   return *this;
+}
+
+OutputBuffer &OutputBuffer::operator<<(double d)
+{
+   char number[32];
+
+   // doubles only show up in debugging output
+   snprintf(number, sizeof(number), "%g", d);
+   return *this << (const char *)number;
+}
+
+#endif
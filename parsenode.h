@@ -8,7 +8,7 @@
 #include "token.h"
 
 typedef enum {zero,v0,v1,a0,a1,a2,a3,t0,t1,t2,t3,t4,t5,t6,t7,t8,t9,
-              s0,s1,s2,s3,s4,s5,s6,s7,sp,fp,ra} Reg;
+              s0,s1,s2,s3,s4,s5,s6,s7,gp,sp,fp,ra} Reg;
 
 typedef enum {DeclKind, StmtKind, ExpKind} NodeKind;
 typedef enum {FuncDecl, VarDecl, ParamDecl } DeclNode;
@@ -17,7 +17,12 @@ typedef enum {NumExp, VarExp, AssignExp, OpExp, CallExp,RelExp} ExpNode;
 typedef enum {Void, Integer, Array} Type;
 
 #define MAXCHILDREN 3
-#define MAXPARAMS 8
+// the parameter number of anything that isn't a parameter
+#define NOTPARAM -1
+// the symbol of a node that isn't bound to a declaration
+#define NOSYMBOL 0xffffffffu
+// the memory location of a global that isn't in the small data
+#define NOTSMALL -1
 
 class ParseNode
 {
@@ -34,7 +39,10 @@ class ParseNode
       int lineNo;
       int linePos;
       int memory;
+      unsigned int symbol;
       unsigned int scope;
+      unsigned int hash;
+      bool hashed;
       bool leaf;
       ParseNode *children[MAXCHILDREN];
       ParseNode *sibling;
@@ -51,13 +59,13 @@ class ParseNode
       // NUM constructor 
       ParseNode (int val);
       // display a node
-      void displayNode(void);
+      void displayNode(OutputBuffer &out);
       // set bool leaf to isLeaf
       void setLeaf(bool isLeaf);
       // returns leaf
       bool getLeaf(){return leaf;}
       // sets the cString value
-      void setString(char *string){strcpy(cString,string);}
+      void setString(char *string){strcpy(cString,string); hashed = false;}
       // sets the DeclType
       void setDeclType(DeclNode dn){decl = dn;}
       // set the Type
@@ -100,6 +108,11 @@ class ParseNode
       void setNum(int number){numVal=number;}
       // returns cString
       char *getString(){return cString;}
+      // returns the hash of cString. It is only computed the first time
+      // it is asked for since the symbol table needs it on every lookup.
+      unsigned int getHash(void);
+      // hashes a null terminated string
+      static unsigned int hashString(const char *s);
       // returns line number
       int getLineNo(void) { return lineNo;}
       // retuns line position
@@ -133,10 +146,15 @@ class ParseNode
       // this function gets the register used
       Reg getReg(void) {return reg;}
       // this function sets the parameter number. if the parameter
-      // number is set to MAXPARAMS then it is not a parameter
+      // number is set to NOTPARAM then it is not a parameter
       void setParamNum(int p) {paramNumber = p;}
       // this function returns the parameter number.
       int getParamNum(void) {return paramNumber;}
+      // this function binds a variable or call to the symbol table entry
+      // of its declaration
+      void setSymbol(unsigned int s) {symbol = s;}
+      // this function returns the bound symbol, or NOSYMBOL
+      unsigned int getSymbol(void) {return symbol;}
       // these should be public so other parts of the program can 
       // use them for output.
       const static char NODE_TYPE[3][STRINGSIZE];
@@ -164,7 +182,9 @@ ParseNode::ParseNode(NodeKind nk, Type tp, int ln, int pos, unsigned int scopePa
       children[i] = NULL;
    sibling = NULL;
    scope = scopeParam;
-   paramNumber = MAXPARAMS;
+   paramNumber = NOTPARAM;
+   hashed = false;
+   symbol = NOSYMBOL;
 }
 
 ParseNode::ParseNode(StmtNode st, int ln, int pos, unsigned int scopeParam)
@@ -178,7 +198,9 @@ ParseNode::ParseNode(StmtNode st, int ln, int pos, unsigned int scopeParam)
       children[i] = NULL;
    sibling = NULL;
    scope = scopeParam;
-   paramNumber = MAXPARAMS;
+   paramNumber = NOTPARAM;
+   hashed = false;
+   symbol = NOSYMBOL;
 
 }
 
@@ -199,7 +221,9 @@ ParseNode::ParseNode(ExpNode expn, Token tk, unsigned int scopeParam)
       type = Integer;
       numVal = numberValue();
    }
-   paramNumber = MAXPARAMS;
+   paramNumber = NOTPARAM;
+   hashed = false;
+   symbol = NOSYMBOL;
 }
 
 ParseNode::ParseNode(NodeKind nk, DeclNode dn, Type tp, char *string, int ln, int pos, unsigned int scopeParam)
@@ -214,7 +238,9 @@ ParseNode::ParseNode(NodeKind nk, DeclNode dn, Type tp, char *string, int ln, in
    scope = scopeParam;
    lineNo = ln;
    linePos = pos;
-   paramNumber = MAXPARAMS;
+   paramNumber = NOTPARAM;
+   hashed = false;
+   symbol = NOSYMBOL;
 
 }
 
@@ -228,43 +254,45 @@ ParseNode::ParseNode(int val)
    numVal = val;
    tt = NUM;
    type = Integer;
-   paramNumber = MAXPARAMS;
+   paramNumber = NOTPARAM;
+   hashed = false;
+   symbol = NOSYMBOL;
 }
 
-void ParseNode::displayNode(void)
+void ParseNode::displayNode(OutputBuffer &out)
 {
    if (nodekind==DeclKind)
    {
-      cout << NODE_TYPE[nodekind] << " ";
-      cout << cString << " ";
-      cout << DECL_TYPE[decl] << " ";
-      cout << TYPE_TYPE[type] << endl;
+      out << NODE_TYPE[nodekind] << " ";
+      out << cString << " ";
+      out << DECL_TYPE[decl] << " ";
+      out << TYPE_TYPE[type] << '\n';
    }
    else if (nodekind==StmtKind)
    {
       if (stmt == FuncStmt)
-         cout << STMT_TYPE[stmt] << " " << NODE_TYPE[nodekind] << endl;
+         out << STMT_TYPE[stmt] << " " << NODE_TYPE[nodekind] << '\n';
       else
-         cout << NODE_TYPE[nodekind] << " " << STMT_TYPE[stmt] << endl; 
+         out << NODE_TYPE[nodekind] << " " << STMT_TYPE[stmt] << '\n'; 
    }
    else if (nodekind==ExpKind)
    {
-      cout << NODE_TYPE[nodekind] << " ";
+      out << NODE_TYPE[nodekind] << " ";
       if (exp == AssignExp) 
-         cout << EXPR_TYPE[exp] << endl;
+         out << EXPR_TYPE[exp] << '\n';
       else if (exp == NumExp || exp == VarExp || exp == CallExp)
       {
-         cout << EXPR_TYPE[exp] << " ";
+         out << EXPR_TYPE[exp] << " ";
          if (exp == NumExp)
-            cout << numVal << endl;
+            out << numVal << '\n';
          else
-            cout << cString << endl;
+            out << cString << '\n';
       }
       else if (exp == OpExp || exp == RelExp)
       {
-         cout << EXPR_TYPE[exp] << " ";
-         cout << Token::TYPE_STRINGS[tt]; 
-         cout << endl;
+         out << EXPR_TYPE[exp] << " ";
+         out << Token::TYPE_STRINGS[tt]; 
+         out << '\n';
       }
    } 
 }
@@ -380,6 +408,30 @@ bool ParseNode::isCall()
 
 }
 
+unsigned int ParseNode::getHash()
+{
+   if (!hashed)
+   {
+      hash = hashString(cString);
+      hashed = true;
+   }
+   return hash;
+}
+
+// this is the 32 bit FNV-1a hash. It looks at each character once and
+// spreads similar names (x1, x2, ...) over the whole table.
+unsigned int ParseNode::hashString(const char *s)
+{
+   unsigned int key = 2166136261u;
+
+   while (*s)
+   {
+      key ^= (unsigned char)(*s++);
+      key *= 16777619u;
+   }
+   return key;
+}
+
 bool ParseNode::isReturnStmt()
 {
    if (nodekind == StmtKind && stmt == ReturnStmt)
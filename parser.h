@@ -8,25 +8,28 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#include "options.h"
 #include "parsenode.h"
 #include "symboltable.h"
+#include "analyzer.h"
 #include "codegenerator.h"
 
 class Parse
 {
    private:
+      // tokens, tables and trees are written to the screen through this
+      OutputBuffer console;
       CodeGenerator codeGenerator;
       SymbolTable table;
       Tokenizer tk;
       ParseNode *root;
       int scope;
-      bool mainDeclared;
       int numErrors;
    public:
       // default constructor
       Parse(){ root = NULL;}
-      // constructor using a filename
-      Parse(char *file, bool dbug);
+      // constructor using the command line options
+      Parse(Options &options);
       // deconstructor
       ~Parse(void);
       // return the root of the parse tree
@@ -39,14 +42,13 @@ class Parse
       void displayTable(void);
       // this function helps with the deconstructor
       void deleteTree(ParseNode *headPtr);
-      // this function performs post traversal on the tree
-      void postTraversal(bool debug);
-      // this is a helper function for postTraverse
-      void traverse(ParseNode *tree,bool debug);
+      // this function analyzes the tree and generates code from it
+      void postTraversal(Options &options);
       // this function parses declarations
       ParseNode *parseDeclarations(void);
-      // this function parses terms
-      ParseNode *parseTerm(void);
+      // this function parses terms. If first is given, it is the first
+      // factor of the term, which has already been parsed.
+      ParseNode *parseTerm(ParseNode *first = NULL);
       // this function parses a declaration
       ParseNode *parseDeclaration(void);
       // this function parses params
@@ -62,11 +64,11 @@ class Parse
       // this function parses an expression
       ParseNode *parseExpression(void);
       // this function parses an additive expression
-      ParseNode *parseAdditiveExpression(void);
+      ParseNode *parseAdditiveExpression(ParseNode *first = NULL);
       // this function parses a relational operator
       ParseNode *parseRelop(void);
       // this function parses a simple expression
-      ParseNode *parseSimpleExpression(void);
+      ParseNode *parseSimpleExpression(ParseNode *first = NULL);
       // this function parses a var
       ParseNode *parseVar(void);
       // this function parses a variable declaration
@@ -89,26 +91,20 @@ class Parse
       ParseNode *parseExpressionStatement(void);
       // this function parses a statement
       ParseNode *parseStatement(void);
-      // this function folds a math operator into a number
-      bool fold (ParseNode *op,bool &flag);
-      // this function calls fold
-      void folding(void);
-      // this function handles the return statements
-      void checkReturn(ParseNode *,Type);
-
 
 };
 
-Parse::Parse(char *file, bool dbug)
+Parse::Parse(Options &options)
 {
    scope = 0;
    numErrors = 0;
-   tk.setInput(file);
-   tk.setDebug(dbug);
+   tk.setOutput(&console);
+   tk.setDebug(options.debug);
+   tk.setInput(options.inputFile);
    root=parseDeclarations();
    numErrors += tk.getNumErrors();
-   postTraversal(dbug);
-   if (dbug)
+   postTraversal(options);
+   if (options.debug)
       displayTree();
 }
 
@@ -134,9 +130,9 @@ void Parse::deleteTree(ParseNode *headPtr)
 void Parse::displayTree()
 {
    int spaces = 0;
-   cout << endl;
+   console << '\n';
    display(root, spaces);
-   cout << endl;
+   console << '\n';
 }
 
 void Parse::display(ParseNode* currentRoot, int spaces)
@@ -145,9 +141,9 @@ void Parse::display(ParseNode* currentRoot, int spaces)
       return;
 
    for (int i=0; i<spaces; ++i)
-      cout << " ";
+      console << " ";
 
-   currentRoot->displayNode();
+   currentRoot->displayNode(console);
    for(int j=0; j<MAXCHILDREN; ++j)
       display(currentRoot->getChild(j),spaces+3);
    display(currentRoot->getSibling(),spaces); 
@@ -155,284 +151,27 @@ void Parse::display(ParseNode* currentRoot, int spaces)
 
 void Parse::displayTable()
 {
-   table.displayTable();   
+   table.displayTable(console);
+   table.displayStats(console);
 }
 
-void Parse::postTraversal(bool debug)
+void Parse::postTraversal(Options &options)
 {
-   mainDeclared = false;
-   // call the function to do folding
-   folding();
-   traverse(root, debug);
-   if (!mainDeclared)
-   {
-      cerr << "ERROR: Main Function Not Declared" << endl;
-      ++numErrors;
-   }
-   numErrors += table.getErrors();
-   codeGenerator.generateCode(root,numErrors);
-}
-
-void Parse::traverse (ParseNode *tree,bool debug)
-{  
-   Type treeType;
-
-   if (tree == NULL)
-      return;
-   // this puts everything we need in the symbol table
-   else if (tree == root)
-   {
-      table.startScope(tree);
-      if (debug)
-         displayTable(); 
-   }
-   else if (tree->isFuncBegin())
-   { 
-      // the output function has aldready been inserted, so we do not
-      // want to insert it again
-      if (strcmp(tree->getString(),"output") != 0)
-      {
-         if (mainDeclared)
-         {
-            cerr << "ERROR: Function Declared After Main: ";
-            tree->displayNode();
-            ++numErrors;
-         }
-      
-         if (table.lookup(tree))
-         {
-            // means the function has already been declared
-            cerr << "ERROR: Function Previously Declared: ";
-            tree->displayNode();
-            ++numErrors;
-         }
-         if (tree->isMainDecl())
-         {
-            if (tree->getType() != Void)
-            {
-               cerr << "ERROR: Main Not Declared As Void Function" << endl;
-               ++numErrors;
-            }
-            mainDeclared = true;
-         }
-      
-         table.startScope(tree);
-         if (debug)
-            displayTable();
-         
-         treeType = tree->getType();
-         checkReturn(tree,treeType);
-      }
-   }
-   // this removes all the things we don't need from the symbol table
-   else if (tree->isFuncEnd())
-      table.endScope(); 
-   else if (tree->isMathOperator())
-   {
-      tree->setType(Integer);
-      if (tree->getChild(0)->isRelOp() || tree->getChild(1)->isRelOp())
-      {
-          cerr << "ERROR: Invalid Use of Relational Operator: ";
-          cerr << tree->getChild(0)->getLineNo() << endl;
-          ++numErrors;
-      }
-      if (tree->getChild(0) && tree->getChild(1))
-      {   
-         // first we want to do a lookup to see if these vars 
-         // have been declared and what type they have been
-         // declared as since lookup adds extra type information 
-         // to the node
-         if (tree->getChild(0)->isVar()) 
-         {
-            if (!table.lookup(tree->getChild(0)))
-            {
-               cerr << "ERROR: Undeclared Variable: ";
-               cerr << tree->getChild(0)->getString() << " ";
-               cerr << tree->getChild(0)->getLineNo() << endl;
-               ++numErrors;
-            }
-         }
-         if (tree->getChild(1)->isVar())
-         {
-            if (!table.lookup(tree->getChild(1)))
-            {
-               cerr << "ERROR: Undeclared Variable: ";
-               cerr << tree->getChild(1)->getString() << " ";
-               cerr << tree->getChild(1)->getLineNo() << endl;
-               ++numErrors;
-            }
-         }
-
-         if (tree->getChild(0)->isCall())
-            table.lookup(tree->getChild(0));
-         if (tree->getChild(1)->isCall())
-            table.lookup(tree->getChild(1));
-
-         if (tree->getChild(0)->isMathOperator())
-            tree->getChild(0)->setType(Integer);
-         if (tree->getChild(1)->isMathOperator())
-            tree->getChild(1)->setType(Integer);
-
-         Type child0Type,child1Type;
-         child0Type = tree->getChild(0)->getType();
-         child1Type = tree->getChild(1)->getType();
-         
-         if (child0Type == Void)
-         {
-            cerr << "ERROR: Invalid Use of Void Type: ";
-            cerr << tree->getChild(0)->getString() << " ";
-            cerr << tree->getChild(0)->getLineNo() << endl;
-            ++numErrors;
-         }
-         if (child1Type == Void)
-         {
-            cerr << "ERROR: Invalid Use of Void Type: ";
-            cerr << tree->getChild(1)->getString() << " ";
-            cerr << tree->getChild(1)->getLineNo() << endl;
-            ++numErrors;
-         }
-
-         // we have already sent an error if an array was not 
-         // declared as an int, so we can just do this quick
-         // conversion. If it is an array, we can be sure it is 
-         // either declared as an int or an error has already
-         // been displayed
-         if (child0Type == Array)
-            child0Type = Integer;
-         if (child1Type == Array)
-            child1Type = Integer;
-
-         if (child0Type != child1Type)
-         {
-            cerr << "ERROR: Type Mismatch on Line ";
-            cerr << tree->getLineNo() << endl;
-            ++numErrors;
-         }   
-      }
-   }
-   else if (tree->isRelOp())
-   {
-      if (!table.lookup(tree->getChild(0)) )
-      {
-         if (tree->getChild(0)->isVar())
-         { 
-            cerr << "ERROR: Undeclared Variable: ";
-            cerr << tree->getChild(0)->getString() << " ";
-            cerr << tree->getChild(0)->getLineNo() << endl;
-            ++numErrors;
-         }
-      }
-      if (!table.lookup(tree->getChild(1)) )
-      { 
-         if (tree->getChild(1)->isVar())
-         { 
-            cerr << "ERROR: Undeclared Variable: ";
-            cerr << tree->getChild(1)->getString() << " ";
-            cerr << tree->getChild(1)->getLineNo() << endl;
-            ++numErrors;
-         }
-      }
-      
-      if (tree->getChild(0)->isCall() &&
-          tree->getChild(0)->getType() == Void)
-      {
-         cerr << "ERROR: Invalid Use of Void Type: ";
-         cerr << tree->getChild(0)->getString() << " ";
-         cerr << tree->getChild(0)->getLineNo() << endl;
-         ++numErrors;
-      }
-      if (tree->getChild(1)->isCall() &&
-          tree->getChild(1)->getType() == Void)
-      {
-         cerr << "ERROR: Invalid Use of Void Type: ";
-         cerr << tree->getChild(1)->getString() << " ";
-         cerr << tree->getChild(1)->getLineNo() << endl;
-         ++numErrors;
-      }
-
-   }
-   else if (tree->isCall())
-   {
-      if (!table.lookup(tree))
-      {
-         cerr << "ERROR: Undeclared Function: ";
-         cerr << tree->getString() << " " << tree->getLineNo() << endl;
-         ++numErrors;
-      }
-   }
-   else if (tree->isAssignment())
-   {
-      if (tree->getChild(0)->isVar())
-      {
-         if (!table.lookup(tree->getChild(0)))
-         {
-            cerr << "ERROR: Undeclared Variable: ";
-            cerr << tree->getChild(0)->getString() << " ";
-            cerr << tree->getChild(0)->getLineNo() << endl;
-            ++numErrors;
-         }
-      
-      
-         if (tree->getChild(0)->getType() == Array)
-         {  
-            cerr << "ERROR: Invalid Assignment: ";
-            cerr << tree->getChild(0)->getString() << " ";
-            cerr << tree->getChild(0)->getLineNo() << endl;
-            ++numErrors;
-         }
-      }
+   Analyzer analyzer(table, options.debug, console);
 
-      if (tree->getChild(1)->isRelOp())
-      {
-         cerr << "ERROR: Can Not Assign Relational Operator: ";
-         cerr << tree->getChild(1)->getLineNo() << endl;
-         ++numErrors;
-      }
-
-      if (tree->getChild(1)->isVar())
-      {
-         if(!table.lookup(tree->getChild(1)))
-         {
-            cerr << "ERROR: Undeclared Variable: ";
-            cerr << tree->getChild(1)->getString() << " ";
-            cerr << tree->getChild(1)->getLineNo() <<endl;
-            ++numErrors;
-         }
-      }
-     
-      if (tree->getChild(0)->isCall())
-      {
-         if (table.lookup(tree->getChild(0)) &&
-            tree->getChild(0)->getType() == Void)
-         {
-            cerr << "ERROR: Invalid Use of Void Type: ";
-            cerr << tree->getChild(0)->getString() << " ";
-            cerr << tree->getChild(0)->getLineNo() << endl; 
-            ++numErrors;
-         }
-      }
-      if (tree->getChild(1)->isCall())
-      {
-         if (table.lookup(tree->getChild(1)) && 
-             tree->getChild(1)->getType() == Void)
-         {
-            cerr << "ERROR: Invalid Use of Void Type: ";
-            cerr << tree->getChild(1)->getString() << " ";
-            cerr << tree->getChild(1)->getLineNo() << endl;
-            ++numErrors;
-         }
-      }
-   }
-   else if (tree->isVarDecl() && tree->getScope() == 0)
-   {
-      table.insert(tree);
-   }
-  
-
-   for (unsigned int i=0; i<MAXCHILDREN; ++i)
-      traverse(tree->getChild(i),debug);
-   traverse(tree->getSibling(),debug);
-   
+   // the analyzer reports its errors on stderr, so the parse errors have
+   // to be out first to stay in the order of the source
+   console.flush();
+   // a single walk binds the names, folds constants and checks types
+   analyzer.analyze(root);
+   numErrors += analyzer.getErrors();
+   numErrors += table.getErrors();
+   // everything so far has to be on the screen before the code generator
+   // writes to it or gives up
+   console.flush();
+   codeGenerator.generateCode(root,table,options,numErrors);
+   if (options.debug)
+      codeGenerator.displayStats(console);
 }
 
 ParseNode *Parse::parseDeclarations(void)
@@ -461,10 +200,13 @@ ParseNode *Parse::parseDeclarations(void)
 
 }
 
-ParseNode *Parse::parseTerm(void)
+ParseNode *Parse::parseTerm(ParseNode *first)
 {
    ParseNode *tmp;
-   ParseNode *node = parseFactor();
+   ParseNode *node = first;
+
+   if (!node)
+      node = parseFactor();
    tmp = node;
 
    while(tmp && (tk.isMatch(STAR) || tk.isMatch(DIV))) 
@@ -492,6 +234,13 @@ ParseNode *Parse::parseDeclaration(void)
       node = new ParseNode(DeclKind,VarDecl, Void,"", tk.getLineNo(),tk.getPosition(),scope);
       tk.match(VOID);
    }
+   else
+   {
+      // parseDeclarations calls this for the first declaration without
+      // looking at the token, so an empty file or a stray token ends here
+      tk.match(INT);
+      return NULL;
+   }
    node->setString(tk.getString());
    tk.match(ID);
    if(tk.isMatch(LPAR))
@@ -644,7 +393,7 @@ ParseNode *Parse::parseFunctionStatement(void)
 
 ParseNode *Parse::parseExpression(void)
 {
-   ParseNode *node=NULL, *tmp=NULL,*relop=NULL;
+   ParseNode *node=NULL, *tmp=NULL;
   
    if (tk.isMatch(ID))
    {
@@ -659,48 +408,11 @@ ParseNode *Parse::parseExpression(void)
          node->setChild(0,tmp);
          node->setChild(1,parseSimpleExpression());
       }
-      else if (tk.isMatch(LT) || tk.isMatch(GT) || tk.isMatch(LEQ) ||
-               tk.isMatch(GEQ) || tk.isMatch(EQ) || tk.isMatch(NOTEQ))
-      {
-         // it's hard to figure out whether the variable is the left
-         // hand part of an assignment or a var that is part of a 
-         // simple expression or term or factor. So this is a bad way of 
-         // doing this but we are basically parsing a simple expression 
-         // inside of this function
-         relop = parseRelop();
-         
-         while (relop)
-         {
-            tmp = node;
-            node = new ParseNode (RelExp, tk.getToken(),scope);
-            node->setChild(0,tmp);
-            node->setChild(1,parseAdditiveExpression());
-            relop = parseRelop();
-         }
-      }
-      else if(tk.isMatch(PLUS) || tk.isMatch(MINUS))
-      {
-         while(tk.isMatch(PLUS) || tk.isMatch(MINUS))
-         {
-            tmp = node;
-            node = new ParseNode(OpExp, tk.getToken(),scope);
-            tk.match(tk.getToken().getType());
-            node->setChild(0, tmp);
-            node->setChild(1, parseTerm());
-            
-         }
-      }
-      else if(tk.isMatch(STAR) || tk.isMatch(DIV))
+      else if (node)
       {
-         while(tk.isMatch(STAR) || tk.isMatch(DIV))
-         {
-            tmp = node;
-            node = new ParseNode(OpExp, tk.getToken(),scope);
-            tk.match(tk.getToken().getType());
-            node->setChild(0, tmp);
-            node->setChild(1, parseFactor());
-
-         }
+         // the variable turned out to be the start of a simple
+         // expression, so the rest of the expression is parsed after it
+         node = parseSimpleExpression(node);
       }
    
       if (!node)
@@ -712,11 +424,11 @@ ParseNode *Parse::parseExpression(void)
    return node;
 }
 
-ParseNode *Parse::parseSimpleExpression(void)
+ParseNode *Parse::parseSimpleExpression(ParseNode *first)
 {
    ParseNode *node=NULL, *tmp=NULL, *relop=NULL;
    
-   node = parseAdditiveExpression();
+   node = parseAdditiveExpression(first);
    relop = parseRelop();
 
    if (relop)
@@ -785,13 +497,13 @@ ParseNode *Parse::parseRelop(void)
    return node;
 }
 
-ParseNode *Parse::parseAdditiveExpression(void)
+ParseNode *Parse::parseAdditiveExpression(ParseNode *first)
 {
    ParseNode *tmp;
-   ParseNode *node = parseTerm();
+   ParseNode *node = parseTerm(first);
    tmp = node;
 
-   while(tmp && tk.isMatch(PLUS) || tk.isMatch(MINUS))
+   while(tmp && (tk.isMatch(PLUS) || tk.isMatch(MINUS)))
    {
       
       node = new ParseNode(OpExp, tk.getToken(),scope);
@@ -979,17 +691,12 @@ ParseNode *Parse::parseStatement(void)
 
 ParseNode *Parse::parseVarDeclaration(void)
 {
-   ParseNode *node = NULL;
-   if(tk.isMatch(INT))
-   {
-      node = new ParseNode(DeclKind,VarDecl, Integer,"", tk.getLineNo(), tk.getPosition(),scope);
-      tk.match(INT);
-   }
-   else if (tk.isMatch(VOID))
-   {
-      node = new ParseNode(DeclKind,VarDecl, Void,"", tk.getLineNo(),tk.getPosition(),scope);
-      tk.match(VOID);
-   }
+   // parseLocalDeclarations only calls this on int or void
+   ParseNode *node = new ParseNode(DeclKind,VarDecl,
+                                   tk.isMatch(INT) ? Integer : Void,"",
+                                   tk.getLineNo(),tk.getPosition(),scope);
+
+   tk.match(tk.getToken().getType());
    node->setString(tk.getString());
    tk.match(ID);
    
@@ -1023,125 +730,4 @@ ParseNode *Parse::parseVarDeclaration(void)
    return node;
 }
 
-void Parse::folding()
-{
-   bool condition = false;
-   
-   // if we succeed in folding two nodes we want to check if the new number
-   // node could be folded again.
-   while(fold(root,condition))
-      condition=false;
-   
-}
-
-bool Parse::fold(ParseNode *op, bool &flag)
-{
-   ParseNode *child0,*child1;
-   int number = 0;
- 
-   child0=op->getChild(0);
-   child1=op->getChild(1);
-
-   if (op->isMathOperator())
-   {
-      if (child0->isNum() && child1->isNum())
-      {
-         if (op->getTokenType() == PLUS)
-         {
-            number = child0->getNum() + child1->getNum();
-            flag = true;
-         }
-         else if (op->getTokenType() == MINUS)
-         {
-            number = child0->getNum() - child1->getNum();
-            flag = true;
-         }
-         else if (op->getTokenType() == STAR)
-         {
-            number = child0->getNum() * child1->getNum();
-            flag = true;
-         }
-         else if (op->getTokenType() == DIV)
-         {
-            number = child0->getNum() / child1->getNum();
-            flag = true;
-         }
-
-         deleteTree(child0);
-         deleteTree(child1);
-         op->setChild(0,NULL);
-         op->setChild(1,NULL);
- 
-         op->setExp(NumExp);
-         op->setNum(number);
-      }
-   }
-   
-   if (child0)
-      fold(child0,flag);
-   if (child1)
-      fold(child1,flag);
-   if (op->getSibling())
-      fold(op->getSibling(),flag);
-
-   if (flag)
-      return true;
-   else
-      return false;
-}
-
-void Parse::checkReturn(ParseNode* tree, Type treeType)
-{
-
-   if (tree == NULL)
-      return;
-   else if (tree->isFuncEnd())
-      return;
-   else if (tree->isReturnStmt())
-   {
-      if (treeType == Void)
-      {
-         if (tree->getChild(0) != NULL)
-         {
-            cerr << "ERROR: Void Function Returns A Value: ";
-            cerr << tree->getLineNo() << " " << tree->getPosition() << endl;
-            ++numErrors;
-         }
-      }
-      else if (treeType == Integer)
-      {
-         if (tree->getChild(0) == NULL)
-         {
-            cerr << "ERROR: Integer Function Returns No Value: ";
-            cerr << tree->getLineNo() << " " << tree->getPosition() << endl;
-            ++numErrors;
-         }
-         else 
-         {
-            table.lookup(tree->getChild(0));
-            if (  tree->getChild(0)->getType() != Integer)
-            {
-               if (!tree->getChild(0)->isMathOperator())
-               {
-                  cerr << "ERROR: Integer Function Does Not Return Integer: ";
-                  cerr << tree->getLineNo() << " " << tree->getPosition() << endl;
-                  ++numErrors;
-               }
-            }
-         }
-      }
-   }
-   for (unsigned int i=0; i<MAXCHILDREN; ++i)
-      checkReturn(tree->getChild(i),treeType);
-   // a new declaration can't be a child, but a sibling might be a 
-   // new function declaration that we don't want to look at yet
-   if (tree->getSibling())
-   {
-      if (tree->getSibling()->isFuncBegin())
-         return;
-      else
-         checkReturn(tree->getSibling(),treeType);    
-   }
-}
-
 #endif
@@ -0,0 +1,765 @@
+// By: David Karhi
+//
+//   This is the header file for the Peephole class. The peephole pass
+//   slides a small window over the code of a function and replaces the
+//   patterns that the code generator leaves behind with shorter code.
+//   The patterns are kept in a table. Each one can be turned off on its
+//   own, and the pass counts how many times each one was used. The pass
+//   runs before the frame is laid out, so slots that lose all of their
+//   stores and loads take no space.
+//
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <cstring>
+#include <utility>
+#include "outputbuffer.h"
+#include "machinecode.h"
+
+// the rules, in the order that they are tried at each instruction
+typedef enum {MoveRule,CopyRule,DeadCodeRule,LoadRule,ForwardRule,
+              DeadStoreRule,JumpNextRule,JumpJumpRule,UnreachableRule,
+              LabelRule,ImmediateRule,SelectRule} PeepholeRule;
+
+#define NUMRULES 12
+#define ALLRULES ((1u << NUMRULES) - 1)
+
+class Peephole
+{
+   private:
+      // A rule looks at the code starting at code[i]. If it changes
+      // anything it returns how many instructions it used, so that the
+      // sweep can go on after them, and otherwise it returns 0.
+      typedef unsigned int (Peephole::*Rule)(unsigned int i);
+      struct Pattern
+      {
+         // the name used on the command line and in the stats
+         const char *name;
+         // the most instructions that the rule looks at
+         unsigned int window;
+         Rule rule;
+      };
+      const static Pattern PATTERNS[NUMRULES];
+      // the rules that are turned on, with a bit for each one
+      unsigned int enabled;
+      // how many times each rule was used
+      unsigned int counts[NUMRULES];
+      // the function being worked on and the registers that are live
+      // after each of its instructions
+      MachineFunction *f;
+      vector<unsigned int> liveOut;
+      // for each label, the number of branches to it and where it is
+      vector<int> labelUses;
+      vector<int> labelPlace;
+      // for each slot, true if it is ever loaded from, and true if its
+      // address is ever taken
+      vector<bool> slotRead;
+      vector<bool> slotAddressed;
+      // instructions that go just after code[first], which are added
+      // when the sweep is done so the instructions don't move during it
+      vector<pair<unsigned int, Instruction> > pending;
+
+      // finds the labels and slots that the code uses
+      void findUses(void);
+      // tries every rule at every instruction once
+      bool sweep(void);
+      // takes out the deleted instructions and adds the pending ones
+      void compact(void);
+      void remove(unsigned int i);
+      // returns the first instruction at or after i that isn't a label
+      unsigned int skipLabels(unsigned int i);
+      // returns where a chain of jumps that starts at label l ends up
+      int finalTarget(int l);
+      // returns true if two memory operands are the same word
+      bool sameAddress(const Instruction &a, const Instruction &b);
+      // returns true if a store might change the word another memory
+      // operand uses
+      bool mayAlias(const Instruction &store, const Instruction &access);
+      // returns true if the word a memory operand uses can stay in a
+      // register across a call that leaves the register alone
+      bool survivesCall(const Instruction &access);
+      // returns true if the instruction writes just its rd register
+      bool writesOnlyRd(const Instruction &i);
+      // returns true if the register holds part of the frame or the
+      // address of the small data
+      bool isFrameReg(unsigned char r);
+
+      // mov r,r and mov a,b right after mov b,a
+      unsigned int removeMove(unsigned int i);
+      // an instruction whose result is only moved somewhere else writes
+      // it there instead, and an instruction that reads a copy that is
+      // used once reads the original
+      unsigned int propagateCopy(unsigned int i);
+      // for propagateCopy, makes the code after code[i] and the move of its
+      // result read the copy in place of the result. Returns the last
+      // instruction that changed, or 0 if it can't be done.
+      unsigned int renameResult(unsigned int i);
+      // an instruction whose result is never used
+      unsigned int removeDeadCode(unsigned int i);
+      // a load of a word that is already in a register, and a store of
+      // a word that was just loaded
+      unsigned int removeLoad(unsigned int i);
+      // a load of a word that was just stored becomes a move
+      unsigned int forwardStore(unsigned int i);
+      // a store to a slot that is never read, or that is stored again
+      // before it is read
+      unsigned int removeDeadStore(unsigned int i);
+      // a jump or branch to the label that comes next
+      unsigned int removeJumpToNext(unsigned int i);
+      // a jump or branch to a label that just jumps somewhere else
+      unsigned int threadJump(unsigned int i);
+      // code after a jump that no label leads to
+      unsigned int removeUnreachable(unsigned int i);
+      // a label that nothing branches to
+      unsigned int removeLabel(unsigned int i);
+      // arithmetic with $zero or 0 that is a li or a move
+      unsigned int simplifyImmediate(unsigned int i);
+      // a conditional move into a copy of a register that is then copied
+      // back moves into the register itself
+      unsigned int mergeSelect(unsigned int i);
+   public:
+      Peephole();
+      // turns on only the rules in the mask
+      void setRules(unsigned int rules) {enabled = rules;}
+      // runs the rules over the function until none of them apply
+      void optimize(MachineFunction &function);
+      // shows how many times each rule was used
+      void displayStats(OutputBuffer &out);
+      // returns the rule with the given name, or -1 if there isn't one
+      static int findRule(const char *name);
+};
+
+const Peephole::Pattern Peephole::PATTERNS[] = {
+            {"move", 2, &Peephole::removeMove},
+            {"copy", 8, &Peephole::propagateCopy},
+            {"dead-code", 1, &Peephole::removeDeadCode},
+            {"load", 8, &Peephole::removeLoad},
+            {"forward", 8, &Peephole::forwardStore},
+            {"dead-store", 8, &Peephole::removeDeadStore},
+            {"jump-next", 1, &Peephole::removeJumpToNext},
+            {"jump-jump", 1, &Peephole::threadJump},
+            {"unreachable", 1, &Peephole::removeUnreachable},
+            {"label", 1, &Peephole::removeLabel},
+            {"immediate", 1, &Peephole::simplifyImmediate},
+            {"select", 3, &Peephole::mergeSelect}};
+
+Peephole::Peephole()
+{
+   enabled = ALLRULES;
+   f = NULL;
+   for (int i=0; i<NUMRULES; ++i)
+      counts[i] = 0;
+}
+
+void Peephole::optimize(MachineFunction &function)
+{
+   bool changed = true;
+
+   if (enabled == 0)
+      return;
+   f = &function;
+   while (changed)
+   {
+      findUses();
+      f->findLiveness(liveOut);
+      changed = sweep();
+      compact();
+   }
+}
+
+void Peephole::displayStats(OutputBuffer &out)
+{
+   for (int i=0; i<NUMRULES; ++i)
+   {
+      out << "Peephole " << PATTERNS[i].name << ": ";
+      if (enabled & (1u << i))
+         out << counts[i] << '\n';
+      else
+         out << "off" << '\n';
+   }
+}
+
+int Peephole::findRule(const char *name)
+{
+   for (int i=0; i<NUMRULES; ++i)
+   {
+      if (strcmp(PATTERNS[i].name, name) == 0)
+         return i;
+   }
+   return -1;
+}
+
+void Peephole::findUses()
+{
+   vector<Instruction> &code = f->code;
+
+   labelUses.assign(f->getNumLabels(), 0);
+   labelPlace.assign(f->getNumLabels(), -1);
+   slotRead.assign(f->getNumSlots(), false);
+   slotAddressed.assign(f->getNumSlots(), false);
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].op == place)
+         labelPlace[code[i].target] = i;
+      else if (jumpsToLabel(code[i]))
+         ++labelUses[code[i].target];
+      else if (code[i].mode == SlotAddress && code[i].op == lw)
+         slotRead[code[i].target] = true;
+      else if (code[i].mode == SlotAddress && code[i].op == la)
+         slotAddressed[code[i].target] = true;
+   }
+}
+
+bool Peephole::sweep()
+{
+   vector<Instruction> &code = f->code;
+   unsigned int used;
+   bool changed = false;
+
+   for (unsigned int i=0; i<code.size(); )
+   {
+      used = 0;
+      for (int r=0; r<NUMRULES && used == 0; ++r)
+      {
+         if (enabled & (1u << r))
+         {
+            used = (this->*PATTERNS[r].rule)(i);
+            if (used > 0)
+               ++counts[r];
+         }
+      }
+      if (used > 0)
+      {
+         changed = true;
+         i += used;
+      }
+      else
+         ++i;
+   }
+   return changed;
+}
+
+void Peephole::compact()
+{
+   vector<Instruction> &code = f->code;
+   vector<Instruction> old;
+   unsigned int p = 0;
+
+   // the pending instructions were added in order, so they can be put
+   // in while the code is copied down
+   old.swap(code);
+   for (unsigned int i=0; i<old.size(); ++i)
+   {
+      if (old[i].op != nop)
+         code.push_back(old[i]);
+      for (; p < pending.size() && pending[p].first == i; ++p)
+         code.push_back(pending[p].second);
+   }
+   pending.clear();
+}
+
+void Peephole::remove(unsigned int i)
+{
+   Instruction &ins = f->code[i];
+
+   if (jumpsToLabel(ins))
+      --labelUses[ins.target];
+   ins.op = nop;
+}
+
+unsigned int Peephole::skipLabels(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+
+   while (i < code.size() && (code[i].op == place || code[i].op == nop))
+      ++i;
+   return i;
+}
+
+int Peephole::finalTarget(int l)
+{
+   vector<Instruction> &code = f->code;
+   int target = l;
+   unsigned int i;
+
+   // a chain longer than the number of labels must go around in a circle
+   for (unsigned int hops=0; hops <= labelPlace.size(); ++hops)
+   {
+      if (labelPlace[target] < 0)
+         return target;
+      i = skipLabels(labelPlace[target]);
+      if (i >= code.size() || code[i].op != jmp)
+         return target;
+      target = code[i].target;
+   }
+   return l;
+}
+
+bool Peephole::sameAddress(const Instruction &a, const Instruction &b)
+{
+   return a.mode == b.mode && a.rs == b.rs && a.imm == b.imm &&
+          (a.mode == RegAddress || a.target == b.target);
+}
+
+bool Peephole::mayAlias(const Instruction &store, const Instruction &access)
+{
+   const Instruction *other;
+
+   // a store through a register can reach anything whose address can be
+   // taken, which is every global and any slot that an la was used on
+   if (store.mode == RegAddress || access.mode == RegAddress)
+   {
+      other = (store.mode == RegAddress) ? &access : &store;
+      if (other->mode == SlotAddress)
+         return slotAddressed[other->target];
+      return true;
+   }
+   if (store.mode != access.mode || store.target != access.target)
+      return false;
+   // an index register could reach any word of the variable
+   if (store.rs != zero || access.rs != zero)
+      return true;
+   return store.imm == access.imm;
+}
+
+bool Peephole::survivesCall(const Instruction &access)
+{
+   // The callee can only reach a slot through its address, since its own
+   // slots are somewhere else even when it is this function again. Only
+   // the temporaries that hold values across calls are kept, since the
+   // allocator knows better what to do with the locals.
+   return access.mode == SlotAddress && !slotAddressed[access.target] &&
+          f->getSlot(access.target).kind == TempSlot;
+}
+
+bool Peephole::isFrameReg(unsigned char r)
+{
+   return (REGBIT(r) & (REGBIT(zero) | REGRANGE(gp,ra))) != 0;
+}
+
+bool Peephole::writesOnlyRd(const Instruction &i)
+{
+   switch (i.op)
+   {
+      case add: case sub: case mul: case dvd: case slt: case sle: case sgt:
+      case sge: case seq: case sne: case addiu: case sll: case mov: case li:
+      case lw: case la: case slti: case lui: case ori: case sra: case srl:
+      case mulhi: case eor: case addu: case subu:
+         return true;
+      default:
+         return false;
+   }
+}
+
+unsigned int Peephole::removeMove(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+
+   if (code[i].op != mov)
+      return 0;
+   if (code[i].rd == code[i].rs)
+   {
+      remove(i);
+      return 1;
+   }
+   if (i+1 < code.size() && code[i+1].op == mov &&
+       code[i+1].rd == code[i].rs && code[i+1].rs == code[i].rd)
+   {
+      remove(i+1);
+      return 2;
+   }
+   return 0;
+}
+
+unsigned int Peephole::propagateCopy(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   unsigned int end = i + PATTERNS[CopyRule].window;
+   unsigned int j, last = 0;
+   unsigned char copy, source;
+
+   if (i+1 >= code.size() || !writesOnlyRd(code[i]) || isFrameReg(code[i].rd))
+      return 0;
+
+   Instruction &first = code[i];
+   Instruction &next = code[i+1];
+   if (next.op == mov && next.rs == first.rd && next.rd != first.rd &&
+       next.rd != zero)
+   {
+      last = renameResult(i);
+      if (last > 0)
+      {
+         first.rd = next.rd;
+         remove(i+1);
+         return last-i+1;
+      }
+   }
+
+   // li r,0 is a copy of $zero
+   if (first.op == mov)
+      source = first.rs;
+   else if (first.op == li && first.imm == 0)
+      source = zero;
+   else
+      return 0;
+   copy = first.rd;
+
+   // the instructions after the copy read the source instead, until
+   // either register changes
+   if (end > code.size())
+      end = code.size();
+   for (j=i+1; j<end; ++j)
+   {
+      Instruction &later = code[j];
+
+      if (later.op == place || later.op == nop)
+         break;
+      // calls and syscalls read registers that aren't in their operands
+      if ((later.op == jl || later.op == scall || later.op == jr ||
+           later.op == jt) &&
+          (regsRead(later) & REGBIT(copy)))
+         break;
+      // a memory operand can't take $zero as its address
+      if (later.rs == copy && source == zero && later.mode != NoAddress)
+         break;
+      // a conditional move also reads its rd, which stays the copy
+      if (later.rs == copy || later.rt == copy)
+      {
+         if (later.rs == copy)
+            later.rs = source;
+         if (later.rt == copy)
+            later.rt = source;
+         last = j;
+      }
+      if (endsBlock(later) ||
+          (regsWritten(later) & (REGBIT(copy) | REGBIT(source))))
+         break;
+   }
+   if (last == 0)
+      return 0;
+   return last-i+1;
+}
+
+unsigned int Peephole::renameResult(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   unsigned int end = i + PATTERNS[CopyRule].window;
+   unsigned int j;
+   unsigned char result = code[i].rd, copy = code[i+1].rd;
+
+   if (!(liveOut[i+1] & REGBIT(result)))
+      return i+1;
+
+   // The reads of the result before it dies or changes read the copy
+   // instead. That only works when the copy doesn't change first, and
+   // when nothing after a branch or label still needs the result.
+   if (end > code.size())
+      end = code.size();
+   for (j=i+2; j<end; ++j)
+   {
+      Instruction &later = code[j];
+
+      if (later.op == place || later.op == nop ||
+          later.op == jl || later.op == scall || later.op == jr ||
+          later.op == jt)
+         return 0;
+      if ((later.rs == result || later.rt == result) &&
+          (regsWritten(later) & REGBIT(copy)))
+         return 0;
+      // a conditional move reads its rd, which can't be renamed
+      if ((later.op == movz || later.op == movn) && later.rd == result)
+         return 0;
+      if (!(liveOut[j] & REGBIT(result)) ||
+          (regsWritten(later) & REGBIT(result)))
+         break;
+      if (endsBlock(later) || (regsWritten(later) & REGBIT(copy)))
+         return 0;
+   }
+   if (j == end)
+      return 0;
+   for (unsigned int k=i+2; k<=j; ++k)
+   {
+      if (regsRead(code[k]) & REGBIT(result))
+      {
+         if (code[k].rs == result)
+            code[k].rs = copy;
+         if (code[k].rt == result)
+            code[k].rt = copy;
+      }
+   }
+   return j;
+}
+
+unsigned int Peephole::removeDeadCode(unsigned int i)
+{
+   Instruction &ins = f->code[i];
+
+   if (!writesOnlyRd(ins) || isFrameReg(ins.rd) ||
+       (liveOut[i] & REGBIT(ins.rd)))
+      return 0;
+   remove(i);
+   return 1;
+}
+
+unsigned int Peephole::removeLoad(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   Instruction &load = code[i];
+   unsigned int end = i + PATTERNS[LoadRule].window;
+
+   if (load.op != lw || (REGBIT(load.rd) & REGBIT(load.rs)))
+      return 0;
+   if (end > code.size())
+      end = code.size();
+   for (unsigned int j=i+1; j<end; ++j)
+   {
+      Instruction &next = code[j];
+
+      if (next.op == place || endsBlock(next) ||
+          (next.op == jl && !survivesCall(load)))
+         return 0;
+      if (next.op == sw && sameAddress(next, load) && next.rt == load.rd)
+      {
+         // the word already holds this value
+         remove(j);
+         return j-i+1;
+      }
+      if (next.op == sw && mayAlias(next, load))
+         return 0;
+      if (next.op == lw && sameAddress(next, load))
+      {
+         if (next.rd == load.rd)
+            remove(j);
+         else
+         {
+            next.op = mov;
+            next.rs = load.rd;
+            next.mode = NoAddress;
+         }
+         return j-i+1;
+      }
+      if (regsWritten(next) & (REGBIT(load.rd) | REGBIT(load.rs)))
+         return 0;
+   }
+   return 0;
+}
+
+unsigned int Peephole::forwardStore(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   Instruction &store = code[i];
+   unsigned int end = i + PATTERNS[ForwardRule].window;
+   unsigned int touched = 0;
+   bool overwritten = false;
+   Instruction move = {mov, zero, store.rt, zero, NoAddress, 0, 0};
+
+   if (store.op != sw)
+      return 0;
+   if (end > code.size())
+      end = code.size();
+   for (unsigned int j=i+1; j<end; ++j)
+   {
+      Instruction &next = code[j];
+
+      if (next.op == place || endsBlock(next) ||
+          (next.op == jl && !survivesCall(store)))
+         return 0;
+      if (next.op == lw && sameAddress(next, store))
+      {
+         if (!overwritten)
+         {
+            // the stored register still holds the value
+            if (next.rd == store.rt)
+               remove(j);
+            else
+            {
+               next.op = mov;
+               next.rs = store.rt;
+               next.mode = NoAddress;
+            }
+            return j-i+1;
+         }
+         // otherwise the value is copied before it is lost, as long as
+         // nothing in between uses the register the load writes
+         if ((touched & REGBIT(next.rd)) || next.rd == zero)
+            return 0;
+         move.rd = next.rd;
+         pending.push_back(make_pair(i, move));
+         remove(j);
+         return j-i+1;
+      }
+      if (next.op == sw && mayAlias(next, store))
+         return 0;
+      if (regsWritten(next) & REGBIT(store.rs))
+         return 0;
+      if (regsWritten(next) & REGBIT(store.rt))
+         overwritten = true;
+      touched |= regsRead(next) | regsWritten(next);
+   }
+   return 0;
+}
+
+unsigned int Peephole::removeDeadStore(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   Instruction &store = code[i];
+   unsigned int end = i + PATTERNS[DeadStoreRule].window;
+   bool temporary;
+
+   if (store.op != sw || store.mode == RegAddress)
+      return 0;
+   if (store.mode == SlotAddress && !slotRead[store.target] &&
+       !slotAddressed[store.target])
+   {
+      remove(i);
+      return 1;
+   }
+
+   // An expression has no branches in it, so a temporary that isn't read
+   // by the end of its block never is. Nothing else can reach it, so the
+   // whole block is looked at, calls and all.
+   temporary = store.mode == SlotAddress &&
+               f->getSlot(store.target).kind == TempSlot;
+   // otherwise a store is dead when it is replaced before anything can
+   // read it
+   if (end > code.size() || temporary)
+      end = code.size();
+   for (unsigned int j=i+1; j<end; ++j)
+   {
+      Instruction &next = code[j];
+
+      if (next.op == place || endsBlock(next))
+         break;
+      if (next.op == jl && !temporary)
+         return 0;
+      if (next.op == sw && sameAddress(next, store))
+      {
+         remove(i);
+         return 1;
+      }
+      if ((next.op == lw || next.op == la) && mayAlias(store, next))
+         return 0;
+      if (regsWritten(next) & REGBIT(store.rs))
+         return 0;
+   }
+   if (!temporary)
+      return 0;
+   // the temporary was never read
+   remove(i);
+   return 1;
+}
+
+unsigned int Peephole::removeJumpToNext(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+
+   if (!jumpsToLabel(code[i]))
+      return 0;
+   for (unsigned int j=i+1; j<code.size(); ++j)
+   {
+      if (code[j].op != place && code[j].op != nop)
+         return 0;
+      if (code[j].op == place && code[j].target == code[i].target)
+      {
+         remove(i);
+         return 1;
+      }
+   }
+   return 0;
+}
+
+unsigned int Peephole::threadJump(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   int target;
+
+   if (!jumpsToLabel(code[i]))
+      return 0;
+   target = finalTarget(code[i].target);
+   if (target == code[i].target)
+      return 0;
+   --labelUses[code[i].target];
+   ++labelUses[target];
+   code[i].target = target;
+   return 1;
+}
+
+unsigned int Peephole::removeUnreachable(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+   unsigned int j;
+   bool removed = false;
+
+   if (code[i].op != jmp && code[i].op != jr && code[i].op != jt)
+      return 0;
+   for (j=i+1; j<code.size() && code[j].op != place; ++j)
+   {
+      if (code[j].op != nop)
+      {
+         remove(j);
+         removed = true;
+      }
+   }
+   if (!removed)
+      return 0;
+   return j-i;
+}
+
+unsigned int Peephole::removeLabel(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+
+   if (code[i].op != place || labelUses[code[i].target] > 0)
+      return 0;
+   remove(i);
+   return 1;
+}
+
+unsigned int Peephole::simplifyImmediate(unsigned int i)
+{
+   Instruction &ins = f->code[i];
+
+   if (ins.op == addiu && ins.rs == zero)
+      ins.op = li;
+   else if ((ins.op == addiu || ins.op == sll) && ins.imm == 0)
+      ins.op = mov;
+   else if ((ins.op == add || ins.op == sub || ins.op == addu ||
+             ins.op == subu) && ins.rt == zero)
+      ins.op = mov;
+   else if ((ins.op == add || ins.op == addu) && ins.rs == zero)
+   {
+      ins.op = mov;
+      ins.rs = ins.rt;
+   }
+   else
+      return 0;
+   ins.rt = zero;
+   return 1;
+}
+
+unsigned int Peephole::mergeSelect(unsigned int i)
+{
+   vector<Instruction> &code = f->code;
+
+   if (i+2 >= code.size())
+      return 0;
+   Instruction &copy = code[i];
+   Instruction &select = code[i+1];
+   Instruction &back = code[i+2];
+
+   // The register only changes if the move is made, so when the copy
+   // isn't needed after it goes back, the move can be made to the
+   // register itself.
+   if (copy.op != mov || (select.op != movz && select.op != movn) ||
+       back.op != mov || select.rd != copy.rd || back.rs != copy.rd ||
+       back.rd != copy.rs || select.rs == copy.rd || select.rt == copy.rd ||
+       isFrameReg(copy.rs) || (liveOut[i+2] & REGBIT(copy.rd)))
+      return 0;
+   select.rd = copy.rs;
+   remove(i);
+   remove(i+2);
+   return 3;
+}
+
+#endif
@@ -0,0 +1,432 @@
+// By: David Karhi
+//
+//   This is the header file for the RegisterAllocator class. The
+//   allocator keeps the scalar locals and parameters of a function in
+//   registers instead of in their frame slots. It works out where the
+//   value in each slot is live, makes an interval from the first to the
+//   last of those places, and hands out registers with a linear scan over
+//   the intervals in the order that they start. A value that is needed
+//   after a call gets a $t register that the callee is known to leave
+//   alone, or else a callee-saved $s register, which layoutFrame saves and
+//   restores. Any other value gets a $t register when one is free. When
+//   there aren't enough registers, the interval that ends last stays in
+//   memory.
+//
+//   The same intervals are used to share frame slots. Once the registers
+//   are handed out, the one-word slots that are left in memory, spilled
+//   variables and temporaries alike, are colored so that slots whose
+//   intervals don't overlap use the same storage.
+//
+
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <algorithm>
+#include "outputbuffer.h"
+#include "machinecode.h"
+
+// the registers that the allocator hands out. $t0 through $t3 are the
+// register stack that expressions are worked out on.
+#define ALLOC_TEMPS REGRANGE(t4,t9)
+#define ALLOC_SAVED REGRANGE(s0,s7)
+
+struct LiveInterval
+{
+   // the slot that the interval is for
+   int slot;
+   // the first and last instructions where the value in the slot matters
+   int start, end;
+   // the registers that the calls the value is needed after might change
+   unsigned int clobbered;
+   // true if the value is needed before the function stores to the slot,
+   // which for a parameter means it has to be loaded first
+   bool liveIn;
+   // the register that the slot is kept in, or zero if it stays in memory
+   unsigned char reg;
+};
+
+class RegisterAllocator
+{
+   private:
+      MachineFunction *f;
+      vector<LiveInterval> intervals;
+      // the interval of each slot, or -1 if the slot has to stay in memory
+      vector<int> intervalOf;
+      // how many slots were put in registers and how many stayed in memory
+      unsigned int allocated, spilled;
+      // how many slots were given the storage of another slot
+      unsigned int shared;
+
+      // finds the slots that can be kept in registers, or the ones in
+      // memory that can share storage when inMemory is true
+      void findCandidates(bool inMemory);
+      // works out the interval of each candidate
+      void findIntervals(void);
+      // hands out the registers
+      void scan(void);
+      // replaces the loads and stores of the slots that got registers
+      void rewrite(void);
+      // points the code at the slots that share storage
+      void share(void);
+      // makes the interval include instruction i
+      void extend(LiveInterval &interval, int i);
+      // returns the register in the set with the lowest number
+      unsigned char lowestReg(unsigned int regs);
+   public:
+      RegisterAllocator();
+      void allocate(MachineFunction &function);
+      // lets the slots that are never needed at the same time share storage
+      void colorSlots(MachineFunction &function);
+      // shows how many variables were kept in registers
+      void displayStats(OutputBuffer &out);
+      // shows how many slots share storage
+      void displaySlotStats(OutputBuffer &out);
+};
+
+// orders intervals by where they start
+struct StartsBefore
+{
+   vector<LiveInterval> &intervals;
+   StartsBefore(vector<LiveInterval> &i) : intervals(i) {}
+   bool operator()(int a, int b) {return intervals[a].start < intervals[b].start;}
+};
+
+RegisterAllocator::RegisterAllocator()
+{
+   f = NULL;
+   allocated = 0;
+   spilled = 0;
+   shared = 0;
+}
+
+void RegisterAllocator::allocate(MachineFunction &function)
+{
+   f = &function;
+   findCandidates(false);
+   if (intervals.empty())
+      return;
+   findIntervals();
+   scan();
+   rewrite();
+}
+
+void RegisterAllocator::colorSlots(MachineFunction &function)
+{
+   f = &function;
+   findCandidates(true);
+   if (intervals.empty())
+      return;
+   findIntervals();
+   share();
+}
+
+void RegisterAllocator::displayStats(OutputBuffer &out)
+{
+   out << "Registers: " << allocated << " variables kept in registers, ";
+   out << spilled << " left in memory" << '\n';
+}
+
+void RegisterAllocator::displaySlotStats(OutputBuffer &out)
+{
+   out << "Stack slots: " << shared << " slots share storage" << '\n';
+}
+
+void RegisterAllocator::findCandidates(bool inMemory)
+{
+   vector<Instruction> &code = f->code;
+   vector<bool> candidate(f->getNumSlots(), false);
+   LiveInterval interval = {0, 0, 0, 0, false, zero};
+
+   // a parameter is always one word, since an array parameter holds the
+   // address of the array. It is in the caller's frame, so it can't share
+   // storage with anything.
+   for (unsigned int s=0; s<f->getNumSlots(); ++s)
+   {
+      FrameSlot &slot = f->getSlot(s);
+      if (inMemory)
+         candidate[s] = (slot.kind == LocalSlot || slot.kind == TempSlot) &&
+                        slot.words == 1;
+      else
+         candidate[s] = slot.kind == ParamSlot ||
+                        (slot.kind == LocalSlot && slot.words == 1);
+   }
+   // a slot whose address is taken has to stay in memory
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].mode == SlotAddress &&
+          (code[i].op == la || code[i].imm != 0))
+         candidate[code[i].target] = false;
+   }
+
+   intervals.clear();
+   intervalOf.assign(f->getNumSlots(), -1);
+   for (unsigned int s=0; s<candidate.size(); ++s)
+   {
+      if (candidate[s])
+      {
+         interval.slot = s;
+         intervalOf[s] = intervals.size();
+         intervals.push_back(interval);
+      }
+   }
+}
+
+void RegisterAllocator::findIntervals()
+{
+   vector<Instruction> &code = f->code;
+   unsigned int n = intervals.size();
+   vector<vector<bool> > use, def, in, out;
+   vector<bool> live;
+   bool changed = true;
+   int c;
+
+   f->findBlocks();
+   vector<BasicBlock> &blocks = f->getBlocks();
+   use.assign(blocks.size(), vector<bool>(n, false));
+   def.assign(blocks.size(), vector<bool>(n, false));
+   in.assign(blocks.size(), vector<bool>(n, false));
+   out.assign(blocks.size(), vector<bool>(n, false));
+   for (unsigned int b=0; b<blocks.size(); ++b)
+   {
+      for (unsigned int i=blocks[b].last; i>blocks[b].first; --i)
+      {
+         Instruction &ins = code[i-1];
+
+         if (ins.mode != SlotAddress || (c = intervalOf[ins.target]) < 0)
+            continue;
+         use[b][c] = ins.op == lw;
+         if (ins.op == sw)
+            def[b][c] = true;
+      }
+   }
+
+   // this is the same backwards flow as the register liveness, but with a
+   // bit for each candidate slot
+   while (changed)
+   {
+      changed = false;
+      for (unsigned int b=blocks.size(); b>0; --b)
+      {
+         BasicBlock &block = blocks[b-1];
+
+         for (unsigned int k=0; k<n; ++k)
+         {
+            out[b-1][k] = (block.fallThrough >= 0 && in[block.fallThrough][k]) ||
+                          (block.branchTo >= 0 && in[block.branchTo][k]);
+            if ((use[b-1][k] || (out[b-1][k] && !def[b-1][k])) != in[b-1][k])
+            {
+               in[b-1][k] = !in[b-1][k];
+               changed = true;
+            }
+         }
+      }
+   }
+
+   for (unsigned int k=0; k<n; ++k)
+   {
+      intervals[k].start = code.size();
+      intervals[k].end = -1;
+      intervals[k].liveIn = !blocks.empty() && in[0][k];
+   }
+   for (unsigned int b=0; b<blocks.size(); ++b)
+   {
+      live = out[b];
+      for (unsigned int i=blocks[b].last; i>blocks[b].first; --i)
+      {
+         Instruction &ins = code[i-1];
+
+         for (unsigned int k=0; k<n; ++k)
+         {
+            if (!live[k])
+               continue;
+            extend(intervals[k], i-1);
+            if (ins.op == jl)
+               intervals[k].clobbered |= regsWritten(ins);
+         }
+         if (ins.mode != SlotAddress || (c = intervalOf[ins.target]) < 0)
+            continue;
+         extend(intervals[c], i-1);
+         live[c] = ins.op == lw;
+      }
+   }
+}
+
+void RegisterAllocator::scan()
+{
+   vector<int> order, active;
+   unsigned int busy = 0;
+   unsigned int allowed, free;
+   int victim;
+
+   for (unsigned int k=0; k<intervals.size(); ++k)
+   {
+      // a slot that is never used doesn't need anything
+      if (intervals[k].end >= 0)
+         order.push_back(k);
+   }
+   sort(order.begin(), order.end(), StartsBefore(intervals));
+
+   for (unsigned int o=0; o<order.size(); ++o)
+   {
+      LiveInterval &current = intervals[order[o]];
+
+      // the intervals that are over give their registers back
+      for (unsigned int a=0; a<active.size(); )
+      {
+         if (intervals[active[a]].end < current.start)
+         {
+            busy &= ~REGBIT(intervals[active[a]].reg);
+            active.erase(active.begin()+a);
+         }
+         else
+            ++a;
+      }
+
+      allowed = ALLOC_SAVED | (ALLOC_TEMPS & ~current.clobbered);
+      free = allowed & ~busy;
+      if (free & ALLOC_TEMPS)
+         current.reg = lowestReg(free & ALLOC_TEMPS);
+      else if (free)
+         current.reg = lowestReg(free);
+      else
+      {
+         // the interval that ends last gives up its register, unless that
+         // is this one
+         victim = -1;
+         for (unsigned int a=0; a<active.size(); ++a)
+         {
+            LiveInterval &other = intervals[active[a]];
+
+            if ((REGBIT(other.reg) & allowed) &&
+                (victim < 0 || other.end > intervals[active[victim]].end))
+               victim = a;
+         }
+         if (victim < 0 || intervals[active[victim]].end <= current.end)
+         {
+            ++spilled;
+            continue;
+         }
+         current.reg = intervals[active[victim]].reg;
+         intervals[active[victim]].reg = zero;
+         active.erase(active.begin()+victim);
+         ++spilled;
+         --allocated;
+      }
+      busy |= REGBIT(current.reg);
+      active.push_back(order[o]);
+      ++allocated;
+   }
+}
+
+void RegisterAllocator::rewrite()
+{
+   vector<Instruction> &code = f->code;
+   vector<Instruction> loads;
+   int c;
+
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      Instruction &ins = code[i];
+
+      if (ins.mode != SlotAddress || (c = intervalOf[ins.target]) < 0 ||
+          intervals[c].reg == zero)
+         continue;
+      // a load copies from the register and a store copies to it
+      if (ins.op == lw)
+         ins.rs = intervals[c].reg;
+      else
+      {
+         ins.rd = intervals[c].reg;
+         ins.rs = ins.rt;
+         ins.rt = zero;
+      }
+      ins.op = mov;
+      ins.mode = NoAddress;
+      ins.target = 0;
+   }
+
+   // the parameters that are used before they are stored to start out in
+   // memory
+   for (unsigned int k=0; k<intervals.size(); ++k)
+   {
+      LiveInterval &interval = intervals[k];
+      Instruction load = {lw, interval.reg, zero, zero, SlotAddress, 0,
+                          interval.slot};
+
+      if (interval.reg == zero)
+         continue;
+      if (interval.liveIn && f->getSlot(interval.slot).kind == ParamSlot)
+         loads.push_back(load);
+   }
+   code.insert(code.begin(), loads.begin(), loads.end());
+}
+
+void RegisterAllocator::share()
+{
+   vector<Instruction> &code = f->code;
+   vector<int> order;
+   // the slot that holds each color and the last instruction that uses it
+   vector<int> colorSlot, colorEnd;
+   vector<int> slotOf(f->getNumSlots());
+   unsigned int c;
+
+   for (unsigned int s=0; s<slotOf.size(); ++s)
+      slotOf[s] = s;
+   for (unsigned int k=0; k<intervals.size(); ++k)
+   {
+      if (intervals[k].end >= 0)
+         order.push_back(k);
+   }
+   sort(order.begin(), order.end(), StartsBefore(intervals));
+
+   // every access to a slot is in its interval, so a slot can take over
+   // the storage of any slot whose interval is over
+   for (unsigned int o=0; o<order.size(); ++o)
+   {
+      LiveInterval &current = intervals[order[o]];
+
+      for (c=0; c<colorSlot.size(); ++c)
+      {
+         if (colorEnd[c] < current.start)
+            break;
+      }
+      if (c == colorSlot.size())
+      {
+         colorSlot.push_back(current.slot);
+         colorEnd.push_back(current.end);
+         continue;
+      }
+      slotOf[current.slot] = colorSlot[c];
+      colorEnd[c] = current.end;
+      ++shared;
+      // the peephole pass treats temporaries as dead at the end of their
+      // block, which a local that shares the slot isn't
+      if (f->getSlot(current.slot).kind == LocalSlot)
+         f->getSlot(colorSlot[c]).kind = LocalSlot;
+   }
+
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].mode == SlotAddress)
+         code[i].target = slotOf[code[i].target];
+   }
+}
+
+void RegisterAllocator::extend(LiveInterval &interval, int i)
+{
+   if (i < interval.start)
+      interval.start = i;
+   if (i > interval.end)
+      interval.end = i;
+}
+
+unsigned char RegisterAllocator::lowestReg(unsigned int regs)
+{
+   unsigned char r = 0;
+
+   while (!(regs & REGBIT(r)))
+      ++r;
+   return r;
+}
+
+#endif
@@ -0,0 +1,404 @@
+// By: David Karhi
+//
+//   This is the header file for the Scheduler class. The scheduler runs
+//   once the frame code is in and reorders the instructions inside each
+//   basic block, so that the instruction after a load doesn't need what
+//   it loads and stall a pipelined MIPS. It is a list scheduler. The
+//   instructions whose operands are worked out are ready, and of those it
+//   takes the one on the longest path to the end of the block, preferring
+//   one that wouldn't have to wait.
+//
+//   With delay slots turned on, the code is also made correct for a MIPS
+//   that runs the instruction after a branch or jump before it goes, and
+//   that doesn't have a loaded value ready for the next instruction. Each
+//   slot after a branch or jump gets an instruction from before it that
+//   the branch doesn't depend on, or a nop, and a nop goes after any load
+//   whose value is still needed right away.
+//
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "outputbuffer.h"
+#include "machinecode.h"
+#include "symboltable.h"
+
+// how many cycles after a load its value is ready, where 1 is the next
+// instruction
+#define LOADLATENCY 2
+
+class Scheduler
+{
+   private:
+      // the function being worked on, and the symbols of its globals
+      MachineFunction *f;
+      SymbolTable *table;
+      // true if the blocks are reordered, and true if the code is for a
+      // MIPS with delay slots
+      bool reorder, delays;
+      // for each slot, true if its address is ever taken
+      vector<bool> slotAddressed;
+      // how many instructions moved, how many delay slots were filled
+      // with an instruction, and how many nops went in
+      unsigned int moved, filled, nops;
+
+      // reorders code[first] through code[last-1], which have no labels
+      // in them and nothing that ends the block but code[last-1]
+      void scheduleRegion(unsigned int first, unsigned int last);
+      // returns true if later has to stay after earlier
+      bool dependsOn(const Instruction &later, const Instruction &earlier);
+      // returns how many cycles after earlier the later instruction can go
+      // without waiting for it, when later depends on it
+      static int latency(const Instruction &later, const Instruction &earlier);
+      // returns true if two loads or stores might use the same word and
+      // one of them is a store
+      bool mayConflict(const Instruction &a, const Instruction &b);
+      // returns true if nothing can move past the instruction
+      static bool isBarrier(const Instruction &i);
+      // returns the registers that the instruction itself reads when it
+      // runs, leaving out the ones that a call or return only passes on
+      static unsigned int readsNow(const Instruction &i);
+      // returns true if the instruction assembles to a single machine
+      // word, which is all that fits in a delay slot
+      bool isOneWord(const Instruction &i);
+      // moves an instruction into the delay slot after each branch and
+      // jump, or adds a nop there
+      void fillDelaySlots(void);
+      // adds a nop after each load whose value the next instruction reads
+      void separateLoads(void);
+   public:
+      Scheduler();
+      // turn reordering and delay slots on or off
+      void setReorder(bool r) {reorder = r;}
+      void setDelays(bool d) {delays = d;}
+      // the globals are found in symbols
+      void setTable(SymbolTable &symbols) {table = &symbols;}
+      // schedules the code of the function
+      void schedule(MachineFunction &function);
+      // shows how much the scheduler changed
+      void displayStats(OutputBuffer &out);
+};
+
+Scheduler::Scheduler()
+{
+   f = NULL;
+   table = NULL;
+   reorder = true;
+   delays = false;
+   moved = 0;
+   filled = 0;
+   nops = 0;
+}
+
+void Scheduler::schedule(MachineFunction &function)
+{
+   vector<Instruction> &code = function.code;
+   unsigned int first = 0;
+
+   f = &function;
+   slotAddressed.assign(f->getNumSlots(), false);
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].op == la && code[i].mode == SlotAddress)
+         slotAddressed[code[i].target] = true;
+   }
+
+   // A region ends at a label, or just after anything that nothing can
+   // move past. The end of a block is one of those.
+   for (unsigned int i=0; i<=code.size() && reorder; ++i)
+   {
+      if (i == code.size() || code[i].op == place || code[i].op == nop)
+      {
+         scheduleRegion(first, i);
+         first = i+1;
+      }
+      else if (isBarrier(code[i]))
+      {
+         scheduleRegion(first, i+1);
+         first = i+1;
+      }
+   }
+
+   if (delays)
+   {
+      fillDelaySlots();
+      separateLoads();
+   }
+}
+
+void Scheduler::scheduleRegion(unsigned int first, unsigned int last)
+{
+   vector<Instruction> &code = f->code;
+   unsigned int n = (last > first) ? last-first : 0;
+   vector<vector<unsigned int> > after(n);
+   vector<int> waitingOn(n, 0), height(n, 1), readyAt(n, 0);
+   vector<Instruction> order;
+   int cycle = 0;
+   int best;
+
+   if (n < 3)
+      return;
+
+   // the edges go from each instruction to the later ones that depend on
+   // it, and the height of an instruction is the longest path from it to
+   // the end of the region
+   for (unsigned int j=1; j<n; ++j)
+   {
+      for (unsigned int i=0; i<j; ++i)
+      {
+         if (dependsOn(code[first+j], code[first+i]) ||
+             (j == n-1 && isBarrier(code[first+j])))
+         {
+            after[i].push_back(j);
+            ++waitingOn[j];
+         }
+      }
+   }
+   for (unsigned int i=n; i>0; --i)
+   {
+      for (unsigned int e=0; e<after[i-1].size(); ++e)
+      {
+         int h = height[after[i-1][e]] +
+                 latency(code[first+after[i-1][e]], code[first+i-1]);
+         if (h > height[i-1])
+            height[i-1] = h;
+      }
+   }
+
+   // each pass takes the ready instruction that is best to go next, which
+   // is the first one in the code among the tallest that won't stall, or
+   // the tallest if they all would
+   for (unsigned int k=0; k<n; ++k)
+   {
+      best = -1;
+      for (unsigned int i=0; i<n; ++i)
+      {
+         if (waitingOn[i] != 0)
+            continue;
+         if (best < 0 ||
+             (readyAt[i] <= cycle && readyAt[best] > cycle) ||
+             ((readyAt[i] <= cycle) == (readyAt[best] <= cycle) &&
+              height[i] > height[best]))
+            best = i;
+      }
+      if (best != (int)k)
+         ++moved;
+      if (readyAt[best] > cycle)
+         cycle = readyAt[best];
+      order.push_back(code[first+best]);
+      waitingOn[best] = -1;
+      for (unsigned int e=0; e<after[best].size(); ++e)
+      {
+         unsigned int j = after[best][e];
+         int ready = cycle + latency(code[first+j], code[first+best]);
+
+         --waitingOn[j];
+         if (ready > readyAt[j])
+            readyAt[j] = ready;
+      }
+      ++cycle;
+   }
+   for (unsigned int k=0; k<n; ++k)
+      code[first+k] = order[k];
+}
+
+bool Scheduler::dependsOn(const Instruction &later, const Instruction &earlier)
+{
+   unsigned int laterReads = regsRead(later), laterWrites = regsWritten(later);
+   unsigned int earlierReads = regsRead(earlier);
+   unsigned int earlierWrites = regsWritten(earlier);
+
+   if ((laterReads & earlierWrites) || (laterWrites & earlierReads) ||
+       (laterWrites & earlierWrites))
+      return true;
+   if ((later.op == lw || later.op == sw) &&
+       (earlier.op == lw || earlier.op == sw))
+      return mayConflict(later, earlier);
+   return false;
+}
+
+int Scheduler::latency(const Instruction &later, const Instruction &earlier)
+{
+   if (!(readsNow(later) & regsWritten(earlier)))
+      return 0;
+   return (earlier.op == lw) ? LOADLATENCY : 1;
+}
+
+bool Scheduler::mayConflict(const Instruction &a, const Instruction &b)
+{
+   const Instruction *other;
+
+   if (a.op == lw && b.op == lw)
+      return false;
+   // a store through a register can reach anything whose address can be
+   // taken, which is every global and any slot that an la was used on.
+   // The saves and the stack arguments are at fixed places off $sp, and
+   // no pointer can reach them.
+   if (a.mode == RegAddress && b.mode == RegAddress)
+      return a.rs != sp || b.rs != sp || a.imm == b.imm;
+   if (a.mode == RegAddress || b.mode == RegAddress)
+   {
+      other = (a.mode == RegAddress) ? &b : &a;
+      if ((a.mode == RegAddress ? a.rs : b.rs) == sp)
+         return false;
+      if (other->mode == SlotAddress)
+         return slotAddressed[other->target];
+      return true;
+   }
+   if (a.mode != b.mode || a.target != b.target)
+      return false;
+   // an index register could reach any word of the variable
+   if (a.rs != zero || b.rs != zero)
+      return true;
+   return a.imm == b.imm;
+}
+
+bool Scheduler::isBarrier(const Instruction &i)
+{
+   return endsBlock(i) || i.op == jl || i.op == scall;
+}
+
+unsigned int Scheduler::readsNow(const Instruction &i)
+{
+   switch (i.op)
+   {
+      case jl: case jt: case jmp:
+         return 0;
+      case jr:
+         return REGBIT(i.rs);
+      default:
+         return regsRead(i);
+   }
+}
+
+bool Scheduler::isOneWord(const Instruction &i)
+{
+   int offset;
+
+   switch (i.op)
+   {
+      // SPIM expands these into more than one instruction
+      case dvd: case mulhi: case sle: case sgt: case sge: case seq: case sne:
+         return false;
+      case lw: case sw: case la:
+         break;
+      default:
+         return true;
+   }
+
+   // The address has to be a register and an offset that fits in the
+   // instruction, which is how the AsmPrinter writes a slot or a global
+   // in the small data. Any other label takes a lui as well.
+   switch (i.mode)
+   {
+      case SlotAddress:
+         offset = f->getSlot(i.target).offset + i.imm;
+         if (f->isStatic() && f->getSlot(i.target).kind != ParamSlot)
+            offset += f->getStaticBase();
+         else
+            offset += f->getFrameSize();
+         break;
+      case GlobalAddress:
+         if ((unsigned int)i.target == NOSYMBOL ||
+             table->getEntry(i.target).getMem() == NOTSMALL || i.rs != zero)
+            return false;
+         offset = table->getEntry(i.target).getMem() + i.imm;
+         if (offset < 0 || offset >= SMALLDATA)
+            return false;
+         break;
+      default:
+         offset = i.imm;
+         break;
+   }
+   return offset >= -32768 && offset <= 32767;
+}
+
+void Scheduler::fillDelaySlots()
+{
+   vector<Instruction> &code = f->code;
+   vector<Instruction> filledCode;
+   Instruction slot = {nop, zero, zero, zero, NoAddress, 0, NOLABEL};
+   unsigned int start = 0;
+   int chosen;
+
+   // an instruction can only come from the same block, and not from
+   // before a syscall
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (!endsBlock(code[i]) && code[i].op != jl)
+      {
+         filledCode.push_back(code[i]);
+         if (code[i].op == place || code[i].op == scall)
+            start = filledCode.size();
+         continue;
+      }
+
+      // The slot runs before the branch goes, so an instruction from
+      // before it can move there when the branch doesn't read what it
+      // writes and nothing in between depends on it. A load would leave
+      // its value late at whichever instruction comes next, and a call
+      // sets $ra before its slot runs. Only a single instruction fits.
+      chosen = -1;
+      for (unsigned int c=filledCode.size(); c>start && chosen<0; --c)
+      {
+         Instruction &candidate = filledCode[c-1];
+         bool free = candidate.op != lw && candidate.op != nop &&
+                     isOneWord(candidate) &&
+                     !(readsNow(code[i]) & regsWritten(candidate)) &&
+                     !(code[i].op == jl &&
+                       ((regsRead(candidate) | regsWritten(candidate)) &
+                        REGBIT(ra)));
+
+         for (unsigned int k=c; k<filledCode.size() && free; ++k)
+         {
+            if (dependsOn(filledCode[k], candidate))
+               free = false;
+         }
+         if (free)
+            chosen = c-1;
+      }
+
+      filledCode.push_back(code[i]);
+      if (chosen >= 0)
+      {
+         filledCode.push_back(filledCode[chosen]);
+         filledCode.erase(filledCode.begin()+chosen);
+         ++filled;
+      }
+      else
+      {
+         filledCode.push_back(slot);
+         ++nops;
+      }
+      start = filledCode.size();
+   }
+   code = filledCode;
+}
+
+void Scheduler::separateLoads()
+{
+   vector<Instruction> &code = f->code;
+   Instruction slot = {nop, zero, zero, zero, NoAddress, 0, NOLABEL};
+   unsigned int next;
+
+   for (unsigned int i=0; i<code.size(); ++i)
+   {
+      if (code[i].op != lw || code[i].rd == zero)
+         continue;
+      for (next=i+1; next<code.size() && code[next].op == place; ++next)
+         ;
+      if (next < code.size() && (readsNow(code[next]) & REGBIT(code[i].rd)))
+      {
+         code.insert(code.begin()+i+1, slot);
+         ++nops;
+      }
+   }
+}
+
+void Scheduler::displayStats(OutputBuffer &out)
+{
+   out << "Scheduler: " << moved << " instructions moved, ";
+   out << filled << " delay slots filled, " << nops << " nops" << '\n';
+}
+
+#endif
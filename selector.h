@@ -0,0 +1,417 @@
+// By: David Karhi
+//
+//   This is the header file for the InstructionSelector class. The
+//   selector picks the instructions for the operators of an expression
+//   from a table of tree patterns. Each pattern covers one operator along
+//   with the shape of its operands, such as a constant on the right that
+//   fits in the instruction, and says how many instructions it takes. The
+//   cost of a tree is the cost of its cheapest cover, so a pattern is
+//   chosen by adding its own cost to the cost of the operands that it
+//   leaves to be worked out in registers.
+//
+//   Operands that are made only of constants are folded into one
+//   constant. A multiply by a constant can become shifts and adds, and a
+//   divide by a constant can become shifts or a multiply by a magic number
+//   that keeps the high word, when that costs less than mul or div.
+//
+
+#ifndef SELECTOR_H
+#define SELECTOR_H
+
+#include "parsenode.h"
+#include "machinecode.h"
+
+// what the selector says a call costs, which is more than any expression
+// without one
+#define CALLCOST 1000
+// about how many cycles a mul and a div take, counting the instructions
+// that SPIM adds around a div
+#define MULCOST 4
+#define DIVCOST 38
+
+// how the operands of a pattern are worked out. A constant operand goes in
+// the instruction, and ZeroLeft uses $zero for a constant 0 on the left. A
+// Reduced operand is a constant that the multiply or divide is turned into
+// a sequence of other instructions for.
+typedef enum {RegOperands,SwappedOperands,ImmRight,ImmLeft,ZeroLeft,
+              ReducedRight,ReducedLeft} OperandShape;
+
+// what is done to a constant operand before it goes in the instruction
+typedef enum {SameImm,NegatedImm,NextImm} ImmAdjust;
+
+struct SelectPattern
+{
+   // the operator that the pattern covers
+   TokenType token;
+   // the OperandShape and ImmAdjust
+   unsigned char shape;
+   unsigned char adjust;
+   // the Opcode
+   unsigned char op;
+   // the number of instructions that the pattern takes
+   int cost;
+};
+
+// one term of a multiply by a constant, which is the other operand
+// shifted left and then added or subtracted
+struct ShiftTerm
+{
+   int shift;
+   bool negative;
+};
+
+#define NUMPATTERNS 19
+
+class InstructionSelector
+{
+   private:
+      const static SelectPattern PATTERNS[NUMPATTERNS];
+
+      // returns true if the pattern can cover the node and sets imm to the
+      // constant that goes in the instruction
+      bool matches(const SelectPattern &pattern, ParseNode *node, int &imm);
+      // returns the cost of a pattern when its operands cost left and right
+      int coverCost(const SelectPattern &pattern, int imm, int left,
+                    int right);
+      // returns the pattern that covers the node most cheaply when its
+      // operands cost left and right
+      const SelectPattern &cheapest(ParseNode *node, int left, int right,
+                                    int &imm);
+   public:
+      // returns the cheapest pattern for an OpExp or RelExp node and sets
+      // imm to the constant that goes in the instruction
+      const SelectPattern &select(ParseNode *node, int &imm);
+      // returns how many instructions the cheapest cover of a tree takes
+      int cost(ParseNode *node);
+      // returns true if a value fits in the immediate of an instruction
+      static bool isImmediate(int value);
+      // returns how many instructions it takes to load a constant
+      static int constantCost(int value);
+      // returns true if a node is a number and sets value to it. The
+      // analyzer has already folded every constant tree that it can.
+      static bool isConstant(ParseNode *node, int &value);
+
+      // finds the terms of a multiply by value, in order of falling shift
+      // and with the first one added. The sign of value is left out.
+      static void findShiftTerms(int value, vector<ShiftTerm> &terms);
+      // returns n if value or -value is 2 to the n, and -1 otherwise
+      static int powerOfTwo(int value);
+      // finds the number that a divide by value multiplies by and how far
+      // the high word of the product is shifted afterwards
+      static void findMagic(int value, int &multiplier, int &shift);
+      // these return how many instructions a multiply or divide by value
+      // takes once it is reduced
+      static int multiplyCost(int value);
+      static int divideCost(int value);
+};
+
+// For each operator the register form comes first, so it is the one that
+// is used when nothing else matches. The comparisons that SPIM expands
+// into several instructions cost more, so that a form with a constant is
+// used when it can be. a > b is b < a, and a <= K is a < K+1. The
+// Reduced patterns cost what their sequence does.
+const SelectPattern InstructionSelector::PATTERNS[] = {
+            {PLUS, RegOperands, SameImm, add, 1},
+            {PLUS, ImmRight, SameImm, addiu, 1},
+            {PLUS, ImmLeft, SameImm, addiu, 1},
+            {MINUS, RegOperands, SameImm, sub, 1},
+            {MINUS, ImmRight, NegatedImm, addiu, 1},
+            {MINUS, ZeroLeft, SameImm, sub, 1},
+            {STAR, RegOperands, SameImm, mul, MULCOST},
+            {STAR, ReducedRight, SameImm, mul, 0},
+            {STAR, ReducedLeft, SameImm, mul, 0},
+            {DIV, RegOperands, SameImm, dvd, DIVCOST},
+            {DIV, ReducedRight, SameImm, dvd, 0},
+            {LT, RegOperands, SameImm, slt, 1},
+            {LT, ImmRight, SameImm, slti, 1},
+            {LEQ, RegOperands, SameImm, sle, 3},
+            {LEQ, ImmRight, NextImm, slti, 1},
+            {GT, SwappedOperands, SameImm, slt, 1},
+            {GEQ, RegOperands, SameImm, sge, 3},
+            {EQ, RegOperands, SameImm, seq, 3},
+            {NOTEQ, RegOperands, SameImm, sne, 3}};
+
+const SelectPattern &InstructionSelector::select(ParseNode *node, int &imm)
+{
+   return cheapest(node, cost(node->getChild(0)), cost(node->getChild(1)), imm);
+}
+
+const SelectPattern &InstructionSelector::cheapest(ParseNode *node, int left,
+                                                   int right, int &imm)
+{
+   int best = -1;
+   int bestCost = 0;
+   int c;
+   int value = 0;
+
+   // every operator has a register form, so something always matches
+   imm = 0;
+   for (int p=0; p<NUMPATTERNS; ++p)
+   {
+      if (!matches(PATTERNS[p], node, value))
+         continue;
+      c = coverCost(PATTERNS[p], value, left, right);
+      if (best < 0 || c < bestCost)
+      {
+         best = p;
+         bestCost = c;
+         imm = value;
+      }
+   }
+   return PATTERNS[best];
+}
+
+int InstructionSelector::cost(ParseNode *node)
+{
+   int total, left, right;
+   int imm;
+   ParseNode *arg;
+   const SelectPattern *pattern;
+
+   if (isConstant(node, imm))
+      return constantCost(imm);
+   switch (node->getExp())
+   {
+      case NumExp:
+         return constantCost(node->getNum());
+      case VarExp:
+         // an index that isn't a constant is scaled and added to the base
+         if (node->getChild(0) && !node->getChild(0)->isNum())
+            return cost(node->getChild(0)) + 3;
+         return 1;
+      case CallExp:
+         total = CALLCOST;
+         for (arg = node->getChild(0); arg; arg = arg->getSibling())
+            total += cost(arg);
+         return total;
+      case AssignExp:
+         return cost(node->getChild(0)) + cost(node->getChild(1));
+      case OpExp:
+      case RelExp:
+         left = cost(node->getChild(0));
+         right = cost(node->getChild(1));
+         pattern = &cheapest(node, left, right, imm);
+         return coverCost(*pattern, imm, left, right);
+      default:
+         return 1;
+   }
+}
+
+bool InstructionSelector::isImmediate(int value)
+{
+   return value >= -32768 && value <= 32767;
+}
+
+int InstructionSelector::constantCost(int value)
+{
+   // a lui alone is enough when the low half is 0, and otherwise an ori
+   // fills it in
+   if (isImmediate(value) || (value & 0xffff) == 0)
+      return 1;
+   return 2;
+}
+
+bool InstructionSelector::matches(const SelectPattern &pattern,
+                                  ParseNode *node, int &imm)
+{
+   ParseNode *constant;
+
+   if (pattern.token != node->getTokenType())
+      return false;
+   switch (pattern.shape)
+   {
+      case ImmRight:
+      case ImmLeft:
+         constant = node->getChild(pattern.shape == ImmRight ? 1 : 0);
+         if (!isConstant(constant, imm))
+            return false;
+         // done unsigned, so that INT_MIN and INT_MAX wrap around to
+         // something that isn't an immediate
+         if (pattern.adjust == NegatedImm)
+            imm = -(unsigned int)imm;
+         else if (pattern.adjust == NextImm)
+            imm = (unsigned int)imm+1;
+         return isImmediate(imm);
+      case ZeroLeft:
+         return isConstant(node->getChild(0), imm) && imm == 0;
+      case ReducedRight:
+      case ReducedLeft:
+         constant = node->getChild(pattern.shape == ReducedRight ? 1 : 0);
+         // a divide by 0 is left for the program to find
+         return isConstant(constant, imm) && (pattern.op != dvd || imm != 0);
+      default:
+         return true;
+   }
+}
+
+int InstructionSelector::coverCost(const SelectPattern &pattern,
+                                   int imm, int left, int right)
+{
+   // a constant that goes in the instruction costs nothing
+   switch (pattern.shape)
+   {
+      case ImmRight:
+         return pattern.cost + left;
+      case ImmLeft:
+      case ZeroLeft:
+         return pattern.cost + right;
+      case ReducedRight:
+         if (pattern.op == dvd)
+            return divideCost(imm) + left;
+         return multiplyCost(imm) + left;
+      case ReducedLeft:
+         return multiplyCost(imm) + right;
+      default:
+         return pattern.cost + left + right;
+   }
+}
+
+bool InstructionSelector::isConstant(ParseNode *node, int &value)
+{
+   if (node->getExp() != NumExp)
+      return false;
+   value = node->getNum();
+   return true;
+}
+
+void InstructionSelector::findShiftTerms(int value, vector<ShiftTerm> &terms)
+{
+   unsigned int magnitude = (value < 0) ? -(unsigned int)value : value;
+   unsigned int rest;
+   ShiftTerm term;
+   int top;
+   vector<ShiftTerm> difference;
+
+   // the bits that are set give a sum of shifts
+   terms.clear();
+   term.negative = false;
+   for (top=31; top>=0; --top)
+   {
+      if (magnitude & (1u << top))
+      {
+         term.shift = top;
+         terms.push_back(term);
+      }
+   }
+
+   // a run of set bits is shorter as the next power of two minus the bits
+   // that are missing from it
+   top = terms[0].shift + 1;
+   if (top > 31)
+      return;
+   rest = (1u << top) - magnitude;
+   term.shift = top;
+   difference.push_back(term);
+   term.negative = true;
+   for (int b=top-1; b>=0; --b)
+   {
+      if (rest & (1u << b))
+      {
+         term.shift = b;
+         difference.push_back(term);
+      }
+   }
+   if (difference.size() < terms.size())
+      terms = difference;
+}
+
+int InstructionSelector::powerOfTwo(int value)
+{
+   unsigned int magnitude = (value < 0) ? -(unsigned int)value : value;
+   int n = 0;
+
+   if (magnitude == 0 || (magnitude & (magnitude-1)) != 0)
+      return -1;
+   while (magnitude > 1)
+   {
+      magnitude >>= 1;
+      ++n;
+   }
+   return n;
+}
+
+void InstructionSelector::findMagic(int value, int &multiplier, int &shift)
+{
+   // This is the method in Hacker's Delight for signed division. It finds
+   // the smallest power of two 2^p that makes 2^p/value close enough to a
+   // whole number that rounding it up gives the right quotient for every
+   // dividend.
+   const unsigned int two31 = 0x80000000u;
+   unsigned int ad = (value < 0) ? -(unsigned int)value : value;
+   unsigned int t = two31 + ((unsigned int)value >> 31);
+   unsigned int anc = t - 1 - t%ad;
+   unsigned int q1 = two31/anc, r1 = two31 - q1*anc;
+   unsigned int q2 = two31/ad, r2 = two31 - q2*ad;
+   unsigned int delta;
+   int p = 31;
+
+   do
+   {
+      ++p;
+      q1 = 2*q1;
+      r1 = 2*r1;
+      if (r1 >= anc)
+      {
+         ++q1;
+         r1 -= anc;
+      }
+      q2 = 2*q2;
+      r2 = 2*r2;
+      if (r2 >= ad)
+      {
+         ++q2;
+         r2 -= ad;
+      }
+      delta = ad - r2;
+   } while (q1 < delta || (q1 == delta && r1 == 0));
+
+   multiplier = q2 + 1;
+   if (value < 0)
+      multiplier = -(unsigned int)multiplier;
+   shift = p - 32;
+}
+
+int InstructionSelector::multiplyCost(int value)
+{
+   vector<ShiftTerm> terms;
+   int total;
+
+   if (value == 0)
+      return 1;
+   findShiftTerms(value, terms);
+   // a shift and an add or subtract for each term after the first, and
+   // the shift of the last term
+   total = 2*(terms.size()-1);
+   if (terms.back().shift > 0 || terms.size() > 1)
+      ++total;
+   if (value < 0)
+      ++total;
+   return total;
+}
+
+int InstructionSelector::divideCost(int value)
+{
+   int n = powerOfTwo(value);
+   int multiplier, shift;
+   int total;
+
+   if (n >= 0)
+   {
+      // the sign is moved into the low bits so the shift rounds toward 0
+      total = (n == 0) ? 0 : (n == 1) ? 3 : 4;
+      if (value < 0)
+         ++total;
+      return total;
+   }
+   findMagic(value, multiplier, shift);
+   // the multiply is followed by a mfhi, and the quotient is rounded
+   // toward 0 with two more instructions
+   total = constantCost(multiplier) + MULCOST + 3;
+   if ((value > 0 && multiplier < 0) || (value < 0 && multiplier > 0))
+      ++total;
+   if (shift > 0)
+      ++total;
+   return total;
+}
+
+#endif
@@ -1,33 +1,66 @@
 #ifndef SYMBOLTABLE_H
 #define SYMBOLTABLE_H
 
+#include <vector>
 #include "entry.h"
 
-#define HASHSIZE 211
-
-// we're using chained hashing, so we need a linked list
-struct linkedList
+// the table size is always a power of two so that we can mask the hash
+// instead of dividing by the table size
+#define INITIALSIZE 256
+// the table doubles in size once it is more than MAXLOAD percent full
+#define MAXLOAD 75
+// probe lengths at or above this are counted together by displayStats
+#define MAXHISTOGRAM 16
+
+// we're using open addressing with linear probing, so a bucket holds the
+// index of the innermost entry for a name along with the full hash of that
+// name. The hash lets us skip most of the string compares while probing
+// and lets us grow the table without hashing every name again. A bucket
+// is 8 bytes, so a probe run of 8 fits in a single cache line.
+struct bucket
 {
-   Entry *entry;
-   struct linkedList *next;
+   unsigned int hash;
+   unsigned int entry;
 };
 
-// this is an insert list used to keep track of what we 
-// put into the hash table. 
-struct insertList
+// every insert leaves one of these behind so that it can be undone when
+// its scope ends. The bucket is the one that was changed and previous is
+// the entry it held before the insert, or NOSYMBOL if it was empty.
+struct undoRecord
 {
-   char string[STRINGSIZE];
-   struct insertList *next;
+   unsigned int key;
+   unsigned int previous;
 };
 
 class SymbolTable
 {
    private:
-      struct linkedList *table[HASHSIZE];
-      struct insertList *list;
-      struct insertList *tail;
-      void setNode(struct linkedList*, ParseNode *);
-      unsigned int hashFunction(char *s);
+      struct bucket *table;
+      unsigned int tableSize;
+      unsigned int numNames;
+      // every entry ever inserted, in the order they were inserted. An
+      // entry keeps its index after its scope ends.
+      vector<Entry> entries;
+      // the parameter types of every function, one after another
+      vector<Type> paramTypes;
+      // the undo log holds one record per insert, and each open scope
+      // remembers how long the log was when the scope started
+      vector<struct undoRecord> undoLog;
+      vector<unsigned int> scopeMarks;
+      // the index of the first entry in the open function scope
+      unsigned int firstLocal;
+      // the entries of the input and output functions
+      unsigned int inputSymbol;
+      unsigned int outputSymbol;
+      // returns the bucket holding the string or the empty bucket
+      // where it would be inserted
+      unsigned int findBucket(char *s, unsigned int hash);
+      // doubles the size of the table
+      void grow(void);
+      // undoes the most recent insert
+      void undo(void);
+      // returns how far a bucket is from where its hash wanted it
+      unsigned int probeLength(unsigned int key);
       int numErrors;
    public:
       // this is a constructor for the SymbolTable class
@@ -35,232 +68,269 @@ class SymbolTable
       // this is the deconstructor
       ~SymbolTable();
       // this function displays the entire symbol table
-      void displayTable(void);
+      void displayTable(OutputBuffer &out);
+      // this function displays the load factor and probe lengths
+      void displayStats(OutputBuffer &out);
       // insert returns true if it successfully inserts a node
       bool insert(ParseNode *);
-      // lookup returns true if it finds the given node in the table
-      bool lookup(ParseNode *);
-      // remove returns true if it successfully removes an item
-      bool remove(char *string);
+      // lookup returns the entry that the node's name refers to, or
+      // NOSYMBOL if the name isn't declared
+      unsigned int lookup(ParseNode *);
+      // bind looks up a variable or call and stores the entry and its
+      // type in the node. It returns false if the name isn't declared.
+      bool bind(ParseNode *);
+      // returns an entry by its index
+      Entry &getEntry(unsigned int e) {return entries[e];}
+      // returns the type of a function's i-th parameter
+      Type getParam(Entry &function, unsigned int i)
+         {return paramTypes[function.getParamStart()+i];}
+      // these return the entries of the input and output functions
+      unsigned int getInput(void) {return inputSymbol;}
+      unsigned int getOutput(void) {return outputSymbol;}
       // endScope should be called when leaving a scope
       void endScope(void);
       // startScope should be called when entering a new scope
       void startScope(ParseNode *node);
-      // push puts a string into the insertList
-      void push(char* string);
-      // pop removes a string from the insertList
-       void pop(void);
-      // this returns the top of the stack
-      char *getTop(void);
-      // this function checks function calls against function declarations
-      void checkParams(struct linkedList*, ParseNode *node);
+      // this function checks a bound function call against the
+      // function's declaration
+      void checkParams(ParseNode *node);
       // returns numErrors
       int getErrors(void){return numErrors;}
 };
 
 SymbolTable::SymbolTable()
 {
-   for (unsigned int i=0; i<HASHSIZE; ++i)
-      table[i] = NULL;  
+   tableSize = INITIALSIZE;
+   table = new struct bucket[tableSize];
+   for (unsigned int i=0; i<tableSize; ++i)
+      table[i].entry = NOSYMBOL;  
 
-   list = NULL;
-   tail = NULL;
+   numNames = 0;
    numErrors=0;
+   firstLocal = 0;
+   inputSymbol = NOSYMBOL;
+   outputSymbol = NOSYMBOL;
 }
 
 SymbolTable::~SymbolTable()
 { 
-   struct linkedList *tmp,*remove;
-   struct insertList *pointer,*rmv; 
+   delete [] table;
+}
 
-   for (unsigned int i=0; i<HASHSIZE; ++i)
+void SymbolTable::displayTable(OutputBuffer &out)
+{
+   out << '\n';
+   for (unsigned int i=0; i<entries.size(); ++i)
    {
-      if (table[i])
-      {
-         tmp = table[i]->next;
-         delete table[i];
-         while (tmp)
-         {
-            remove = tmp;
-            tmp = tmp->next;
-            delete remove;
-         }
-      }
-   }        
-   
-   if (list)
+      if (entries[i].isLive())
+         entries[i].displayEntry(out, paramTypes.data());
+   }
+}
+
+void SymbolTable::displayStats(OutputBuffer &out)
+{
+   unsigned int histogram[MAXHISTOGRAM];
+   unsigned int longest = 0;
+   unsigned int length;
+
+   for (unsigned int i=0; i<MAXHISTOGRAM; ++i)
+      histogram[i] = 0;
+
+   for (unsigned int i=0; i<tableSize; ++i)
    {
-      rmv = list;
-      while (rmv)
+      if (table[i].entry != NOSYMBOL)
       {
-         pointer = rmv->next;
-         delete rmv;
-         rmv = pointer;
+         length = probeLength(i);
+         if (length > longest)
+            longest = length;
+         if (length >= MAXHISTOGRAM)
+            length = MAXHISTOGRAM-1;
+         ++histogram[length];
       }
-   } 
-}
+   }
 
-void SymbolTable::displayTable()
-{
-   struct linkedList *list;
-   
-   cout << endl;
-   for (unsigned int i=0; i<HASHSIZE; ++i)
+   out << "Symbol Table: " << numNames << " names in " << tableSize;
+   out << " buckets, load factor " << (double)numNames/tableSize << '\n';
+   out << "   Probe Lengths:";
+   for (unsigned int i=0; i<MAXHISTOGRAM; ++i)
    {
-      list = table[i];
-      while (list)
+      if (histogram[i] > 0)
       {
-         list->entry->displayEntry();
-         list = list->next;
+         out << " " << i;
+         if (i == MAXHISTOGRAM-1)
+            out << "+";
+         out << "=" << histogram[i];
       }
-   }   
+   }
+   out << '\n' << "   Maximum Probe Length: " << longest << '\n';
 }
 
 bool SymbolTable::insert(ParseNode *n)
 {
-   struct linkedList *tmp;
-   unsigned int key = hashFunction(n->getString());
+   struct undoRecord record;
+   unsigned int hash = n->getHash();
+   unsigned int key = findBucket(n->getString(), hash);
    
-   if(table[key]==NULL)
+   if (table[key].entry != NOSYMBOL &&
+       entries[table[key].entry].getScope() == n->getScope())
    {
-      tmp = new linkedList;
-      tmp->next=NULL;
-      push(n->getString());
-      tmp->entry = new Entry(n);
-      table[key]=tmp;
+      cerr << "ERROR: Variable Already Declared: ";
+      cerr << n->getString() << endl;
+      ++numErrors;
+      return false;
    }
+
+   // if the name is already in the table, the new entry hides the old
+   // one until its scope ends
+   record.key = key;
+   record.previous = table[key].entry;
+   undoLog.push_back(record);
+
+   table[key].hash = hash;
+   table[key].entry = entries.size();
+   n->setSymbol(entries.size());
+   entries.push_back(Entry(n, paramTypes));
+   if (scopeMarks.empty())
+      entries.back().setSlot(entries.size()-1);
    else
+      entries.back().setSlot(entries.size()-1-firstLocal);
+   if (record.previous == NOSYMBOL)
    {
-      if (n->getScope() > table[key]->entry->getScope())
-      {
-         tmp = new linkedList;
-         tmp->next=table[key];
-         push(n->getString());
-         tmp->entry = new Entry(n);
-         table[key] = tmp;   
-      }
-      else
-      {
-         tmp = table[key];
-         while(tmp)
-         {
-            if(strcmp(tmp->entry->getString(),n->getString())==0)
-            {
-               if (table[key]->entry->getScope() == n->getScope())
-               {
-                  cerr << "ERROR: Variable Already Declared: ";
-                  cerr << n->getString() << endl;
-                  ++numErrors;
-                  return false;
-               }
-            }
-            tmp=tmp->next;
-         }
-         push(n->getString());
-         tmp->entry = new Entry(n);
-         tmp->next = table[key];
-         table[key]=tmp;
-      }
+      ++numNames;
+      if (numNames*100 > tableSize*MAXLOAD)
+         grow();
    }
    return true;
 }
 
-bool SymbolTable::lookup(ParseNode *n)
+unsigned int SymbolTable::lookup(ParseNode *n)
 {
-   struct linkedList *tmp;
-   unsigned int key = hashFunction(n->getString());
-   if(table[key]==NULL)
-   {
-      return false;
-   }
-   tmp = table[key];
-   while(tmp)
-   {
-      if(strcmp(tmp->entry->getString(),n->getString())==0)
-      {
-         if (tmp->entry->getScope() <=  n->getScope())
-         {
-            setNode(tmp,n);
-            return true;
-         }
-      }
-      tmp=tmp->next;
-   }
+   unsigned int key = findBucket(n->getString(), n->getHash());
+   unsigned int e = table[key].entry;
+
+   if (e != NOSYMBOL && entries[e].getScope() <= n->getScope())
+      return e;
 
-   return false;
+   return NOSYMBOL;
 }
 
-bool SymbolTable::remove(char* string)
+bool SymbolTable::bind(ParseNode *node)
 {
-   struct linkedList *tmp, *remove;
-   unsigned int key = hashFunction(string);
-   
-   if (table[key] == NULL)
+   unsigned int e = lookup(node);
+
+   if (e == NOSYMBOL)
       return false;
-   else if (strcmp(table[key]->entry->getString(),string)==0)
-   {
-      tmp = table[key]->next;
-      delete table[key];
-      table[key] = tmp;
-      return true;
-   }
-   else 
-   {
-      tmp = table[key];
-      while (tmp->next && strcmp(tmp->next->entry->getString(),string)!=0)
-         tmp = tmp->next;
-      remove=tmp->next;
-      tmp->next=remove->next;
-      delete remove;
-      return true;
-   }  
+
+   node->setSymbol(e);
+   node->setType(entries[e].getType());
+   // if the variable has a child, that means it's an array location
+   // and the type should be set to Integer instead of Array.
+   if (node->isVar() && node->getChild(0))
+      node->setType(Integer);
+   return true;
 }
 
-unsigned int SymbolTable::hashFunction(char *s)
+unsigned int SymbolTable::findBucket(char *s, unsigned int hash)
 {
-   unsigned int key = 0;
+   unsigned int mask = tableSize - 1;
+   unsigned int key = hash & mask;
 
-   for(unsigned i =0; i< strlen(s); ++i)
+   while (table[key].entry != NOSYMBOL)
    {
-      key=(key+(unsigned(s[i]))<<2) % HASHSIZE ;
+      if (table[key].hash == hash && entries[table[key].entry].nameMatch(s))
+         return key;
+      key = (key+1) & mask;
    }
    return key;
 }
 
+void SymbolTable::grow()
+{
+   struct bucket *old = table;
+   unsigned int oldSize = tableSize;
+   unsigned int *moved = new unsigned int[oldSize];
+   unsigned int mask,key;
+
+   tableSize *= 2;
+   mask = tableSize - 1;
+   table = new struct bucket[tableSize];
+   for (unsigned int i=0; i<tableSize; ++i)
+      table[i].entry = NOSYMBOL;
+
+   // the names are put back in the order they were first inserted, which
+   // is the order of the records that filled an empty bucket. That keeps
+   // the table looking as if it had always been this size, so undoing the
+   // newest insert never has to move any other name.
+   for (unsigned int i=0; i<undoLog.size(); ++i)
+   {
+      if (undoLog[i].previous == NOSYMBOL)
+      {
+         key = old[undoLog[i].key].hash & mask;
+         while (table[key].entry != NOSYMBOL)
+            key = (key+1) & mask;
+         table[key] = old[undoLog[i].key];
+         moved[undoLog[i].key] = key;
+      }
+      undoLog[i].key = moved[undoLog[i].key];
+   }
+   delete [] moved;
+   delete [] old;
+}
+
+void SymbolTable::undo()
+{
+   struct undoRecord record = undoLog.back();
+
+   undoLog.pop_back();
+   entries[table[record.key].entry].setLive(false);
+   table[record.key].entry = record.previous;
+
+   // since inserts are undone newest first, every name whose probe ran
+   // past this bucket was inserted after it and is already gone. That
+   // means the bucket can simply be emptied.
+   if (record.previous == NOSYMBOL)
+      --numNames;
+}
+
+unsigned int SymbolTable::probeLength(unsigned int key)
+{
+   return (key - (table[key].hash & (tableSize-1))) & (tableSize-1);
+}
+
 void SymbolTable::startScope(ParseNode *node)
 {
    ParseNode *tmp;
    int paramNumber = 0;
    int memLocation = 0;
+   unsigned int function = NOSYMBOL;
    
    // we start a scope when we reach a function declaration,
    // so first we want to check if we need to insert that declaration
    if (node->isFuncBegin() )
    {
-      // check if this is global scope
+      // input and output are global, so they don't start a scope
       if (strcmp(node->getString(),"input")==0)
       { 
-         insert(node);
-         if (node->getSibling())
-         {
-            tmp= node->getSibling();
-            insert(tmp);
-         }
-         if (tmp && tmp->getSibling())
-            tmp = tmp->getSibling();
-
-         // mark the end of scope and return
-         push("$"); 
+         if (insert(node))
+            inputSymbol = entries.size()-1;
+         if (node->getSibling() && insert(node->getSibling()))
+            outputSymbol = entries.size()-1;
          return;
       }
 
-      // function declarations are global, so pop the 
-      // scope separator and then push it after the function 
-      // declaration is inserted
-      pop();
-      insert(node);
-      push("$");
-   
+      // function declarations are global, so the declaration is
+      // inserted before the scope is opened
+      if (insert(node))
+         function = entries.size()-1;
+   }
+
+   // the scope starts wherever the undo log is now, and its entries
+   // start at the end of the entries array
+   scopeMarks.push_back(undoLog.size());
+   firstLocal = entries.size();
+
+   if (node->isFuncBegin() )
+   {
       // next, child 0 and its siblings are parameters that need
       // to be inserted
       if (node->getChild(0))
@@ -307,99 +377,32 @@ void SymbolTable::startScope(ParseNode *node)
          }  
       }
    }
-   // we end the scope with a $ character
-   push("$");
-}
 
-void SymbolTable::endScope()
-{
-   // first, pop out the $ char
-   pop(); 
-   while(strcmp(getTop(),"$") != 0)
-   { 
-      remove(getTop());
-      pop();
-   }                              // the $ character. So we push the $
+   // the parameters and locals are now the function's slots
+   if (function != NOSYMBOL)
+      entries[function].setLocals(firstLocal, entries.size()-firstLocal);
 }
 
-void SymbolTable::push(char* string)
-{
-   // we want to stick a $ character at the beginning of the stack
-   // so that we have a divider
-   if (!list)
-   {
-      list = new struct insertList;
-      strcpy(list->string,"$");
-      list->next= new struct insertList;
-      tail = list->next;
-      strcpy(tail->string,string);
-      tail->next = NULL;
-   }
-   else 
-   {
-      tail->next = new struct insertList;
-      tail = tail->next;
-      strcpy(tail->string,string);
-      tail->next=NULL;
-   }
-}
-
-void SymbolTable::pop()
+void SymbolTable::endScope()
 {
-   struct insertList *tmp,*remove;
-    
-   tmp = list;
-   while (tmp->next && tmp->next != tail)
-      tmp = tmp->next;
-
-   remove = tail;
-   tail = tmp;
-   delete remove;
-   tail->next = NULL;
-}
+   if (scopeMarks.empty())
+      return;
 
-void SymbolTable::setNode(struct linkedList *tmp,ParseNode * node)
-{
-   node->setType(tmp->entry->getType());
-   // if the variable has a child, that means it's an array location
-   // and the type should be set to Integer instead of Array.
-   if (node->isVar())
-   {
-      if (node->getChild(0))
-      {
-         node->setType(Integer);
-      }
-   }
-   // we're going to need the some information to
-   // calculate the location on the stack later.
-   node->setParamNum(tmp->entry->getParamNum());
-   node->setMem(tmp->entry->getMem());  
-   
-
-   // check if this is a call
-   if (node->getNodeKind() == ExpKind &&
-       node->getExp() == CallExp)
-   {
-      checkParams(tmp,node);
-   }
-}
-
-char *SymbolTable::getTop()
-{
-   if (tail && tail->string)
-      return tail->string;
-   else
-      return NULL;
+   // undo everything inserted since the scope started
+   while (undoLog.size() > scopeMarks.back())
+      undo();
+   scopeMarks.pop_back();
 }
 
-void SymbolTable::checkParams(struct linkedList *tmp, ParseNode *node)
+void SymbolTable::checkParams(ParseNode *node)
 {
+   Entry &tmp = entries[node->getSymbol()];
    ParseNode *pointer;
    unsigned int callParamSize = 0;
    unsigned int declParamSize;
    Type type1,type2;
 
-   declParamSize = tmp->entry->getParamSize();
+   declParamSize = tmp.getParamSize();
    if (declParamSize > 0)
    {
       pointer = node->getChild(0);
@@ -419,16 +422,15 @@ void SymbolTable::checkParams(struct linkedList *tmp, ParseNode *node)
    }
 
    pointer = node->getChild(0);
-   for (unsigned short int i=0; i<tmp->entry->getParamSize(); ++i)
+   for (unsigned short int i=0; i<tmp.getParamSize(); ++i)
    {
       if(pointer)
       {
-         lookup(pointer);
          if (pointer->isMathOperator())
             type1 = Integer;
          else
             type1 = pointer->getType();
-         type2 = tmp->entry->getParam(i);
+         type2 = getParam(tmp,i);
 
          if (type1 != type2)
          {
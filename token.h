@@ -13,6 +13,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include "outputbuffer.h"
+
 #define STRINGSIZE 256
 #define NUMTYPES 29
 
@@ -38,8 +40,8 @@ class Token
       Token();
       // setToken sets all the values of the token at once
       void setToken(TokenType tt, char *cs, int ln, int pos);
-      // displayToken outputs the token to the screen
-      void displayToken();
+      // displayToken outputs the token to the given buffer
+      void displayToken(OutputBuffer &out);
       // isMatch returns true if two tokens have the same token type
       bool isMatch(TokenType tt){return tt == type;}
       // getType returns the token type
@@ -80,12 +82,12 @@ void Token::setToken(TokenType tt, char *cs, int ln, int pos)
    position = pos;
 }
 
-void Token::displayToken()
+void Token::displayToken(OutputBuffer &out)
 {
-   cout << TYPE_STRINGS[type] << " ";
-   cout << cString << " ";
-   cout << lineNo << " ";
-   cout << position << " " << endl; 
+   out << TYPE_STRINGS[type] << " ";
+   out << cString << " ";
+   out << lineNo << " ";
+   out << position << " " << '\n';
    
 }
 
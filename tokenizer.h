@@ -44,6 +44,8 @@ class Tokenizer
       int pos;
       int numErrors;
       bool debug;
+      // tokens and parse errors are written here
+      OutputBuffer *output;
 
    public:
        // default constuctor
@@ -85,6 +87,8 @@ class Tokenizer
       int getNumErrors(void) {return numErrors;}
       // sets the debug flag
       void setDebug(bool dbug){debug = dbug;}
+      // sets the buffer that tokens and parse errors are written to
+      void setOutput(OutputBuffer *out){output = out;}
       // get the peekToken
       Token getPeek(){ return peekToken;}
 
@@ -96,6 +100,8 @@ Tokenizer::Tokenizer(void)
    line=1;
    pos=0;
    numErrors = 0;
+   debug = false;
+   output = NULL;
 
 }
 
@@ -115,6 +121,7 @@ Tokenizer::Tokenizer(char *filename,bool dbug)
    pos=0;
    numErrors = 0;
    debug = dbug;
+   output = NULL;
    // load this class with tokens
    nextToken();
    token=peekToken;
@@ -147,30 +154,35 @@ void Tokenizer::match(TokenType tt)
    {
       if (isMatch(ERROR) && strcmp("Buffer",token.getString())==0)
       {
-         cout << "ERROR: Buffer Overflow: ";
-         token.displayToken();
+         *output << "ERROR: Buffer Overflow: ";
+         token.displayToken(*output);
       }
       else if (isMatch(ERROR) && strcmp("EOF",token.getString())==0)
       {
-         cout << "ERROR: Unexpected End of File: ";
-         token.displayToken();
+         *output << "ERROR: Unexpected End of File: ";
+         token.displayToken(*output);
       }
       else
       {
-         cout << "ERROR: Unexpected Symbol: ";
-         token.displayToken();
-         cout << "   Expected: " << Token::TYPE_STRINGS[tt] << endl;
+         *output << "ERROR: Unexpected Symbol: ";
+         token.displayToken(*output);
+         *output << "   Expected: " << Token::TYPE_STRINGS[tt] << '\n';
       }
       ++numErrors;
+      // the symbol table reports its errors on stderr as soon as it finds
+      // them, so each error is written out now to keep them in order
+      output->flush();
    }
 
    if (numErrors >= NUMERRORS)
    {
-      cout << "ERROR LIMIT EXCEEDED...EXITING" << endl;
+      *output << "ERROR LIMIT EXCEEDED...EXITING" << '\n';
+      // exit() skips the destructors, so the buffer is written out here
+      output->flush();
       exit (EXIT_FAILURE);
    }
    if (debug)
-      token.displayToken();
+      token.displayToken(*output);
    token = peekToken;
    nextToken();
 }
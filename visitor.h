@@ -0,0 +1,115 @@
+// By: David Karhi
+//
+//   This is the header file for the TreeVisitor template. A class that
+//   walks the parse tree derives from TreeVisitor<itself, Result> and
+//   defines a visit function for each kind of node that it cares about.
+//   visit() looks at the kind of a node once and calls the matching
+//   visit function of the derived class. The call is bound at compile
+//   time, so there are no virtual calls. Any visit function that the
+//   derived class doesn't define falls back to visitNode(), which just
+//   visits the children.
+//
+
+#ifndef VISITOR_H
+#define VISITOR_H
+
+#include "parsenode.h"
+
+template <class Derived, class Result>
+class TreeVisitor
+{
+   public:
+      // calls the visit function for the kind of node. A NULL node
+      // returns Result().
+      Result visit(ParseNode *node);
+      // visits a node and all of its siblings
+      void visitList(ParseNode *node);
+      // visits every child of a node along with the child's siblings
+      void visitChildren(ParseNode *node);
+      // this is what every visit function does unless it is replaced
+      Result visitNode(ParseNode *node) {visitChildren(node); return Result();}
+
+      // declarations
+      Result visitFuncDecl(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitVarDecl(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitParamDecl(ParseNode *node) {return derived()->visitNode(node);}
+      // statements
+      Result visitIfStmt(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitWhileStmt(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitReturnStmt(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitExpStmt(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitCmpStmt(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitFuncStmt(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitEndFunc(ParseNode *node) {return derived()->visitNode(node);}
+      // expressions
+      Result visitNumExp(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitVarExp(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitAssignExp(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitOpExp(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitCallExp(ParseNode *node) {return derived()->visitNode(node);}
+      Result visitRelExp(ParseNode *node) {return derived()->visitNode(node);}
+   private:
+      Derived *derived(void) {return static_cast<Derived *>(this);}
+};
+
+template <class Derived, class Result>
+Result TreeVisitor<Derived,Result>::visit(ParseNode *node)
+{
+   if (node == NULL)
+      return Result();
+
+   switch (node->getNodeKind())
+   {
+      case DeclKind:
+         switch (node->getDeclType())
+         {
+            case FuncDecl: return derived()->visitFuncDecl(node);
+            case VarDecl: return derived()->visitVarDecl(node);
+            case ParamDecl: return derived()->visitParamDecl(node);
+         }
+         break;
+      case StmtKind:
+         switch (node->getStmt())
+         {
+            case IfStmt: return derived()->visitIfStmt(node);
+            case WhileStmt: return derived()->visitWhileStmt(node);
+            case ReturnStmt: return derived()->visitReturnStmt(node);
+            case ExpStmt: return derived()->visitExpStmt(node);
+            case CmpStmt: return derived()->visitCmpStmt(node);
+            case FuncStmt: return derived()->visitFuncStmt(node);
+            case EndFunc: return derived()->visitEndFunc(node);
+         }
+         break;
+      case ExpKind:
+         switch (node->getExp())
+         {
+            case NumExp: return derived()->visitNumExp(node);
+            case VarExp: return derived()->visitVarExp(node);
+            case AssignExp: return derived()->visitAssignExp(node);
+            case OpExp: return derived()->visitOpExp(node);
+            case CallExp: return derived()->visitCallExp(node);
+            case RelExp: return derived()->visitRelExp(node);
+         }
+         break;
+   }
+   return Result();
+}
+
+template <class Derived, class Result>
+void TreeVisitor<Derived,Result>::visitList(ParseNode *node)
+{
+   while (node)
+   {
+      derived()->visit(node);
+      node = node->getSibling();
+   }
+}
+
+template <class Derived, class Result>
+void TreeVisitor<Derived,Result>::visitChildren(ParseNode *node)
+{
+   for (int i=0; i<MAXCHILDREN; ++i)
+      visitList(node->getChild(i));
+}
+
+#endif